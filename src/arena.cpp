@@ -0,0 +1,129 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <atomic>
+
+struct Arena::Block
+{
+    Block *next;
+    size_t capacity;
+
+    char* GetData() { return reinterpret_cast<char*>(this + 1); }
+};
+
+Arena::Arena(size_t block_size)
+    : first_(NULL), current_(NULL), base_(NULL), used_(0), capacity_(0),
+      block_size_(block_size), reserved_(0)
+{
+}
+
+Arena::~Arena()
+{
+    while (first_)
+    {
+        Block *next = first_->next;
+        free(first_);
+        first_ = next;
+    }
+}
+
+void Arena::Rewind(const Mark &mark)
+{
+    current_ = static_cast<Block*>(mark.block);
+    used_ = mark.used;
+    if (current_)
+    {
+        base_ = current_->GetData();
+        capacity_ = current_->capacity;
+    }
+    else
+    {
+        // Rewound to before the first allocation.
+        base_ = NULL;
+        capacity_ = 0;
+    }
+}
+
+void* Arena::AllocateSlow(size_t size, size_t align)
+{
+    // Move on to the next block that is large enough, and insert a new
+    // block in front of the others if none is.
+    Block *prev = current_;
+    Block *block = current_? current_->next : first_;
+    size_t need = size + align;
+    while (block && block->capacity < need)
+    {
+        prev = block;
+        block = block->next;
+    }
+    if (block == NULL)
+    {
+        size_t capacity = (need > block_size_)? need : block_size_;
+        block = static_cast<Block*>(malloc(sizeof(Block) + capacity));
+        if (block == NULL)
+            throw std::bad_alloc();
+        block->capacity = capacity;
+        block->next = NULL;
+        reserved_ += capacity;
+        Block *&link = current_? current_->next : first_;
+        block->next = link;
+        link = block;
+    }
+    else if (prev != current_)
+    {
+        // Skipped blocks that are too small stay in the list, after this
+        // one, for smaller requests.
+        prev->next = block->next;
+        Block *&link = current_? current_->next : first_;
+        block->next = link;
+        link = block;
+    }
+
+    current_ = block;
+    base_ = block->GetData();
+    capacity_ = block->capacity;
+    used_ = 0;
+    return Allocate(size, align);
+}
+
+Arena& GetThreadArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+#ifdef _DEBUG
+
+static std::atomic<int64_t> heap_allocations(0);
+
+void* operator new(size_t size)
+{
+    ++heap_allocations;
+    void *p = malloc(size? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+int64_t GetHeapAllocationCount()
+{
+    return heap_allocations;
+}
+
+#else
+
+int64_t GetHeapAllocationCount()
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef HOLDEM_ARENA_H
+#define HOLDEM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+
+/**
+ * Hands out scratch memory by bumping a pointer through a list of large
+ * blocks. Nothing is freed individually: the arena is rewound to an
+ * earlier mark (see ArenaScope), and the blocks are kept for the next
+ * query, so once the blocks have grown to the largest query the arena
+ * makes no more calls to the heap.
+ *
+ * The blocks are taken from malloc directly, so they are not counted by
+ * GetHeapAllocationCount.
+ */
+class Arena
+{
+public:
+    /// Position in the arena to rewind to.
+    struct Mark
+    {
+        void *block;
+        size_t used;
+    };
+
+    explicit Arena(size_t block_size = 1 << 20);
+    ~Arena();
+
+    /// Returns size bytes aligned on align, which must be a power of two.
+    void* Allocate(size_t size, size_t align)
+    {
+        size_t offset = (((uintptr_t)base_ + used_ + align - 1) & ~(align - 1))
+                        - (uintptr_t)base_;
+        if (base_ == NULL || offset + size > capacity_)
+            return AllocateSlow(size, align);
+        used_ = offset + size;
+        return base_ + offset;
+    }
+
+    /// Returns an array of n value-initialized objects. The objects are
+    /// never destroyed, so T must be trivially destructible.
+    template <class T>
+    T* New(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are never destroyed");
+        T *p = static_cast<T*>(Allocate(n * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < n; i++)
+            new (p + i) T();
+        return p;
+    }
+
+    /// Returns the current position.
+    Mark GetMark() const
+    {
+        Mark mark = { current_, used_ };
+        return mark;
+    }
+
+    /// Frees everything allocated since the mark was taken.
+    void Rewind(const Mark &mark);
+
+    /// Returns the total size of the blocks.
+    size_t GetReservedSize() const { return reserved_; }
+
+private:
+    struct Block;
+
+    void* AllocateSlow(size_t size, size_t align);
+
+    Block *first_;			/* first block of the list */
+    Block *current_;		/* block being allocated from */
+    char *base_;			/* data of the current block */
+    size_t used_;			/* bytes used in the current block */
+    size_t capacity_;		/* bytes in the current block */
+    size_t block_size_;		/* minimum size of a new block */
+    size_t reserved_;		/* total size of the blocks */
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+};
+
+/// Returns the arena of the calling thread.
+Arena& GetThreadArena();
+
+/**
+ * Rewinds the thread's arena when it goes out of scope, so that a query
+ * that allocates its scratch data inside a scope leaves the arena as it
+ * found it. Scopes nest.
+ */
+class ArenaScope
+{
+public:
+    ArenaScope() : arena_(GetThreadArena()), mark_(arena_.GetMark()) { }
+    ~ArenaScope() { arena_.Rewind(mark_); }
+
+    /// Returns an array of n value-initialized objects from the arena.
+    template <class T>
+    T* New(size_t n) { return arena_.New<T>(n); }
+
+private:
+    Arena &arena_;
+    Arena::Mark mark_;
+
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+};
+
+/**
+ * Returns the number of calls to operator new since the program started.
+ * The count is only kept in debug builds, where it is used to check that
+ * the query paths make no heap allocations once warmed up; release builds
+ * return -1.
+ */
+int64_t GetHeapAllocationCount();
+
+#endif /* HOLDEM_ARENA_H */
@@ -0,0 +1,282 @@
+#include "board.h"
+#include <algorithm>
+#include <cassert>
+
+BoardContext::BoardContext(const Hand &board)
+    : board_(board), rank_sum_(0), table_(GetRankSumTable()), 
+      ranks_present_(0), ranks_paired_(false)
+{
+    assert(board.GetCardCount() == 5);
+
+    // A suit has three or more cards if its counter (the top three bits of
+    // each 16-bit group) has bit 0x4 set, or has both bit 0x2 and bit 0x1
+    // set.
+    uint64_t sc = board.value & 0xE000E000E000E000ULL;
+    flush_possible_ = ((sc & 0x8000800080008000ULL) |
+                       (sc & (sc << 1) & 0x4000400040004000ULL)) != 0;
+
+    uint64_t v = board.GetCardSet();
+    while (v)
+    {
+        int b = intrinsic::bit_scan_forward(v);
+        RankMask r = (RankMask)(1 << (b & 15));
+        ranks_paired_ = ranks_paired_ || (ranks_present_ & r) != 0;
+        ranks_present_ |= r;
+        rank_sum_ += RankKeys[b & 15];
+        v &= (v - 1);
+    }
+}
+
+uint32_t ResolveShowdown(const BoardContext &board, const Hand *holes,
+                         int num_players, HandStrength *best_strength)
+{
+    assert(num_players <= 32);
+
+    // The bound only pays off where a full evaluation costs more than the
+    // bound itself: on a flush board, which goes through EvaluateHand, and
+    // only if the board is unpaired, since the bound on a paired board is 
+    // too loose to rule anybody out.
+    bool use_bound = board.IsFlushPossible() && !board.IsPaired();
+
+    HandStrength best;
+    uint32_t winners = 0;
+    for (int i = 0; i < num_players; i++)
+    {
+        if (use_bound && winners != 0 && 
+            board.GetUpperBound(holes[i]) < best.GetCategory())
+            continue;
+
+        HandStrength strength = board.Evaluate(holes[i]);
+        if (winners == 0 || strength > best)
+        {
+            best = strength;
+            winners = 1U << i;
+        }
+        else if (strength == best)
+        {
+            winners |= 1U << i;
+        }
+    }
+
+    if (best_strength)
+        *best_strength = best;
+    return winners;
+}
+
+BoardTexture ClassifyBoard(const Hand &board)
+{
+    uint64_t v = board.GetCardSet();
+    uint64_t sc = board.value >> 13;
+    uint32_t c0 = (uint32_t)(sc & 7), c1 = (uint32_t)((sc >> 16) & 7);
+    uint32_t c2 = (uint32_t)((sc >> 32) & 7), c3 = (uint32_t)((sc >> 48) & 7);
+    uint32_t num_cards = c0 + c1 + c2 + c3;
+    uint32_t max_suit = std::max(std::max(c0, c1), std::max(c2, c3));
+    uint32_t num_suits = (c0 != 0) + (c1 != 0) + (c2 != 0) + (c3 != 0);
+
+    // Rank-count masks, as in EvaluateHand.
+    RankMask m0 = (uint16_t)v, m1 = (uint16_t)(v >> 16);
+    RankMask m2 = (uint16_t)(v >> 32), m3 = (uint16_t)(v >> 48);
+    RankMask ranks_present = m0 | m1 | m2 | m3;
+    RankMask ranks_2_times = (m0 & m1) | (m0 & m2) | (m0 & m3) | 
+                             (m1 & m2) | (m1 & m3) | (m2 & m3);
+    RankMask ranks_3_times = (m0 & m1 & m2) | (m0 & m1 & m3) | 
+                             (m0 & m2 & m3) | (m1 & m2 & m3);
+    RankMask ranks_4_times = m0 & m1 & m2 & m3;
+
+    // A board of five cards has at most two pairs.
+    RankMask pairs = ranks_2_times & ~ranks_3_times;
+    uint32_t num_pairs = (pairs != 0) + ((pairs & (pairs - 1)) != 0);
+    uint32_t has_trips = (ranks_3_times & ~ranks_4_times) != 0;
+    uint32_t pairing = (ranks_4_times != 0)? (uint32_t)Pairing_Quads :
+                       (has_trips && num_pairs)? (uint32_t)Pairing_FullHouse :
+                       has_trips? (uint32_t)Pairing_Trips : num_pairs;
+
+    // Count the board ranks in every window of five consecutive ranks at
+    // once. Bit i of the mask m stands for the window whose lowest rank is
+    // i (the ace is copied below the duce); adding up the five shifted 
+    // masks into rank-count style masks gives, for each k, the windows 
+    // that hold at least k board ranks.
+    uint32_t m = ((uint32_t)ranks_present << 1) | (ranks_present >> 12);
+    uint32_t window_1 = 0, window_2 = 0, window_3 = 0, window_4 = 0, window_5 = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t x = (m >> i) & 0x3FF;
+        window_5 |= window_4 & x;
+        window_4 |= window_3 & x;
+        window_3 |= window_2 & x;
+        window_2 |= window_1 & x;
+        window_1 |= x;
+    }
+    uint32_t conn = (window_5 != 0) + (window_4 != 0) + (window_3 != 0) +
+                    (window_2 != 0) + (window_1 != 0);
+
+    uint32_t to_come = (num_cards < 5);
+    uint32_t high = intrinsic::bit_scan_reverse(ranks_present);
+    uint32_t bucket = (high >= Rank_9) + (high >= Rank_Q) + (high >= Rank_Ace);
+
+    return BoardTexture(num_cards | (pairing << 3) | (max_suit << 6) |
+        (num_suits << 9) | (conn << 12) | ((uint32_t)(conn >= 3) << 15) |
+        ((uint32_t)(conn >= 2 && to_come) << 16) | 
+        ((uint32_t)(max_suit >= 3) << 17) |
+        ((uint32_t)(max_suit >= 2 && to_come) << 18) | (high << 19) |
+        (bucket << 23));
+}
+
+void ClassifyBoards(const Hand *boards, BoardTexture *textures, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        textures[i] = ClassifyBoard(boards[i]);
+    }
+}
+
+/// Adds the ranks in a mask to the rank masks m, where m[k] holds the ranks
+/// present at least k + 1 times.
+static void AddRanks(uint32_t m[4], uint32_t ranks)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        uint32_t carry = m[k] & ranks;
+        m[k] |= ranks;
+        ranks = carry;
+    }
+}
+
+/// Returns true if a mask of ranks holds five consecutive ranks, the ace
+/// also counting low.
+static bool HasStraight(uint32_t ranks)
+{
+    uint32_t m = (ranks << 1) | (ranks >> Rank_Ace);
+    return (m & (m >> 1) & (m >> 2) & (m >> 3) & (m >> 4)) != 0;
+}
+
+/// Returns the category of the ranks in the rank masks m, ignoring flushes.
+static HandCategory GetRankCategory(const uint32_t m[4])
+{
+    if (m[3])
+        return FourOfAKind;
+    if (m[2] && (m[1] & (m[1] - 1)))
+        return FullHouse;
+    if (HasStraight(m[0]))
+        return Straight;
+    if (m[2])
+        return ThreeOfAKind;
+    if (m[1] & (m[1] - 1))
+        return TwoPair;
+    return m[1]? OnePair : HighCard;
+}
+
+int CountCategories(const Hand &board, CardSet dead,
+                    int counts[NUM_HAND_CATEGORIES])
+{
+    int num_board = board.GetCardCount();
+    assert(num_board >= 3 && num_board <= 5);
+
+    uint64_t live_cards = ~(board.value | dead) & 0x1FFF1FFF1FFF1FFFULL;
+    uint32_t board_ranks[4] = { 0, 0, 0, 0 };
+    uint32_t lanes[4], live[4];
+    int num_live[13] = { 0 };
+    for (int s = 0; s < 4; s++)
+    {
+        lanes[s] = (uint32_t)(board.value >> (16 * s)) & 0x1FFF;
+        live[s] = (uint32_t)(live_cards >> (16 * s)) & 0x1FFF;
+        AddRanks(board_ranks, lanes[s]);
+        for (uint32_t m = live[s]; m != 0; m &= m - 1)
+            ++num_live[intrinsic::bit_scan_forward(m)];
+    }
+
+    // Categorize each pair of ranks, ignoring flushes, and count its live
+    // combinations.
+    HandCategory rank_category[13][13];
+    for (int c = 0; c < NUM_HAND_CATEGORIES; c++)
+        counts[c] = 0;
+    int num_combos = 0;
+    for (int r1 = 0; r1 < 13; r1++)
+    {
+        for (int r2 = r1; r2 < 13; r2++)
+        {
+            uint32_t m[4] = { board_ranks[0], board_ranks[1], board_ranks[2],
+                              board_ranks[3] };
+            AddRanks(m, 1U << r1);
+            AddRanks(m, 1U << r2);
+            HandCategory category = GetRankCategory(m);
+            rank_category[r1][r2] = rank_category[r2][r1] = category;
+
+            int n = (r1 == r2)? num_live[r1] * (num_live[r1] - 1) / 2 :
+                                num_live[r1] * num_live[r2];
+            counts[category] += n;
+            num_combos += n;
+        }
+    }
+
+    // At most one suit has three or more cards on the board. A pair with
+    // h cards of that suit makes a flush if the board has 5 - h of them.
+    int suit = -1;
+    for (int s = 0; s < 4; s++)
+    {
+        if (intrinsic::pop_count(lanes[s]) >= 3)
+            suit = s;
+    }
+    if (suit < 0)
+        return num_combos;
+
+    uint32_t flush_ranks = lanes[suit];
+    uint32_t live_suited = live[suit];
+    int num_suited = intrinsic::pop_count(flush_ranks);
+    int num_offsuit[13];
+    for (int r = 0; r < 13; r++)
+        num_offsuit[r] = num_live[r] - (int)((live_suited >> r) & 1);
+
+    // Moves n combinations of the ranks r1 and r2 that make a flush with
+    // the given ranks of the suit.
+    auto move = [&](int r1, int r2, uint32_t suited_ranks, int n)
+    {
+        HandCategory from = rank_category[r1][r2];
+        HandCategory to = HasStraight(suited_ranks)? StraightFlush :
+                          std::max(from, Flush);
+        counts[from] -= n;
+        counts[to] += n;
+    };
+
+    for (uint32_t a = live_suited; a != 0; a &= a - 1)
+    {
+        int x = intrinsic::bit_scan_forward(a);
+        uint32_t with_x = flush_ranks | (1U << x);
+
+        // Both cards of the suit.
+        if (num_suited >= 3)
+        {
+            for (uint32_t b = a & (a - 1); b != 0; b &= b - 1)
+            {
+                int y = intrinsic::bit_scan_forward(b);
+                move(x, y, with_x | (1U << y), 1);
+            }
+        }
+
+        // One card of the suit.
+        if (num_suited >= 4)
+        {
+            for (int y = 0; y < 13; y++)
+            {
+                if (num_offsuit[y] > 0)
+                    move(x, y, with_x, num_offsuit[y]);
+            }
+        }
+    }
+
+    // No card of the suit.
+    if (num_suited >= 5)
+    {
+        for (int r1 = 0; r1 < 13; r1++)
+        {
+            for (int r2 = r1; r2 < 13; r2++)
+            {
+                int n = (r1 == r2)? num_offsuit[r1] * (num_offsuit[r1] - 1) / 2 :
+                                    num_offsuit[r1] * num_offsuit[r2];
+                if (n > 0)
+                    move(r1, r2, flush_ranks, n);
+            }
+        }
+    }
+    return num_combos;
+}
@@ -0,0 +1,208 @@
+#ifndef HOLDEM_BOARD_H
+#define HOLDEM_BOARD_H
+
+#include "hand.h"
+#include "intrinsic.hpp"
+
+/**
+ * Represents a complete five-card board together with the information that
+ * every player's evaluation on that board shares. Build it once per board
+ * and evaluate each player's hole cards against it.
+ *
+ * When no suit has three or more cards on the board, no player can make a
+ * flush or straight flush, whatever the hole cards. (This is the case for
+ * most boards.) The strength of a player's hand then only depends on the
+ * multiset of its ranks, and the board routes every player through the rank
+ * sum table: the rank key sum of the board is computed once, and each
+ * player only adds the keys of the two hole cards and does one lookup.
+ *
+ * The board also provides a cheap upper bound on the category a player can
+ * reach, so that a showdown can skip players who provably cannot beat or
+ * tie the best hand found so far.
+ */
+class BoardContext
+{
+public:
+    explicit BoardContext(const Hand &board);
+
+    /// Returns the five cards of the board.
+    const Hand& GetBoard() const { return board_; }
+
+    /// Returns true if a player can make a flush on this board.
+    bool IsFlushPossible() const { return flush_possible_; }
+
+    /// Returns true if two or more board cards have the same rank.
+    bool IsPaired() const { return ranks_paired_; }
+
+    /// Evaluates the strength of the given two hole cards on this board.
+    HandStrength Evaluate(const Hand &hole) const
+    {
+        if (flush_possible_)
+            return EvaluateHand(board_ + hole);
+
+        uint64_t cards = hole.GetCardSet();
+        uint32_t sum = rank_sum_
+            + RankKeys[intrinsic::bit_scan_forward(cards) & 15]
+            + RankKeys[intrinsic::bit_scan_reverse(cards) & 15];
+        return table_.Lookup(sum);
+    }
+
+    /**
+     * Returns an upper bound on the category of the given hole cards on
+     * this board, computed from a few masks without evaluating the hand.
+     * On an unpaired board without a flush for the player, the bound is 
+     * the exact category; on a paired board it may be loose.
+     */
+    HandCategory GetUpperBound(const Hand &hole) const
+    {
+        // A flush, and possibly a straight flush, needs a counter of five
+        // or more in the combined hand (see EvaluateHand).
+        if (flush_possible_)
+        {
+            uint64_t sc = (board_.value + hole.value) & 0xE000E000E000E000ULL;
+            if (sc & ((sc << 1) | (sc << 2)) & 0x8000800080008000ULL)
+                return StraightFlush;
+        }
+
+        // A paired board leaves room for a full house or four-of-a-kind.
+        if (ranks_paired_)
+            return FourOfAKind;
+
+        uint64_t v = hole.GetCardSet();
+        RankMask r1 = (RankMask)(1 << (intrinsic::bit_scan_forward(v) & 15));
+        RankMask r2 = (RankMask)(1 << (intrinsic::bit_scan_reverse(v) & 15));
+        RankMask ranks = ranks_present_ | r1 | r2;
+        RankMask m = (ranks << 1) | (ranks >> 12);
+        if (m & (m << 1) & (m << 2) & (m << 3) & (m << 4))
+            return Straight;
+
+        // On an unpaired board, every pair involves a hole card.
+        if (r1 == r2)
+            return (r1 & ranks_present_)? ThreeOfAKind : OnePair;
+        return (HandCategory)(((r1 & ranks_present_) != 0) + 
+                              ((r2 & ranks_present_) != 0));
+    }
+
+private:
+    Hand board_;
+    bool flush_possible_;
+    uint32_t rank_sum_;
+    RankSumTable table_;
+    RankMask ranks_present_;
+    bool ranks_paired_;
+};
+
+/**
+ * Settles a showdown on the board and returns a bit-mask of the winning
+ * players (more than one bit is set for a tie). The best strength is
+ * stored in best_strength if it is not null.
+ *
+ * Players are visited in index order. On a board where a flush is possible
+ * and no rank is paired (IsFlushPossible() && !IsPaired()), a player whose
+ * upper bound is below the category of the best hand so far is not
+ * evaluated at all; on other boards every player is evaluated, since the
+ * evaluation is already cheap or the bound too loose to rule anybody out.
+ */
+uint32_t ResolveShowdown(const BoardContext &board, const Hand *holes,
+                         int num_players, HandStrength *best_strength);
+
+/// Represents how the ranks of a board pair up.
+enum BoardPairing
+{
+    Pairing_None = 0,
+    Pairing_Pair = 1,
+    Pairing_TwoPair = 2,
+    Pairing_Trips = 3,
+    Pairing_FullHouse = 4,
+    Pairing_Quads = 5
+};
+
+/// Represents how the suits of a board are distributed.
+enum BoardSuitedness
+{
+    Suits_Rainbow = 0,	/* no two cards of the same suit */
+    Suits_TwoTone = 1,	/* some, but not all, cards of the same suit */
+    Suits_Monotone = 2	/* all cards of the same suit */
+};
+
+/**
+ * Represents the texture of a flop, turn or river board.
+ *
+ * To keep bulk classification cheap, the features are packed into a 
+ * 32-bit integer as follows:
+ *
+ *    31  25 24 23 22  19 18 17 16 15 14  12 11   9 8    6 5    3 2    0
+ *   +------+-----+------+--+--+--+--+------+------+------+------+------+
+ *   |  0   |  HB | high |FD|FP|SD|SP| conn | suits| maxs | pair |  n   |
+ *   +------+-----+------+--+--+--+--+------+------+------+------+------+
+ *
+ *   n      number of cards on the board (3 to 5)
+ *   pair   BoardPairing
+ *   maxs   number of cards of the most common suit
+ *   suits  number of distinct suits
+ *   conn   the most board ranks within any five consecutive ranks (with
+ *          the ace also counting low), i.e. how connected the board is
+ *   SP     a straight can be made with two hole cards (conn >= 3)
+ *   SD     a straight draw can be held with cards to come (conn >= 2)
+ *   FP     a flush can be made with two hole cards (maxs >= 3)
+ *   FD     a flush draw can be held with cards to come (maxs >= 2)
+ *   high   the highest rank on the board
+ *   HB     bucket of the highest rank: 0 for eight or lower, 1 for nine
+ *          to jack, 2 for queen or king, 3 for ace
+ */
+struct BoardTexture
+{
+    uint32_t value;
+
+    BoardTexture() : value(0) { }
+    explicit BoardTexture(uint32_t _value) : value(_value) { }
+
+    int GetCardCount() const { return value & 7; }
+    BoardPairing GetPairing() const { return (BoardPairing)((value >> 3) & 7); }
+    int GetMaxSuitCount() const { return (value >> 6) & 7; }
+    int GetSuitCount() const { return (value >> 9) & 7; }
+    int GetConnectedness() const { return (value >> 12) & 7; }
+    bool IsStraightPossible() const { return (value >> 15) & 1; }
+    bool IsStraightDrawPossible() const { return (value >> 16) & 1; }
+    bool IsFlushPossible() const { return (value >> 17) & 1; }
+    bool IsFlushDrawPossible() const { return (value >> 18) & 1; }
+    Rank GetHighRank() const { return (Rank)((value >> 19) & 15); }
+    int GetHighBucket() const { return (value >> 23) & 3; }
+
+    BoardSuitedness GetSuitedness() const
+    {
+        if (GetSuitCount() == 1)
+            return Suits_Monotone;
+        return (GetSuitCount() == GetCardCount())? Suits_Rainbow : Suits_TwoTone;
+    }
+};
+
+/**
+ * Classifies a board of three to five cards. The features are computed 
+ * directly from the suit lanes and suit counters of the hand with bit
+ * operations, without data-dependent branches.
+ */
+BoardTexture ClassifyBoard(const Hand &board);
+
+/// Classifies a batch of boards with ClassifyBoard.
+void ClassifyBoards(const Hand *boards, BoardTexture *textures, size_t count);
+
+/// Number of hand categories, from HighCard to StraightFlush.
+#define NUM_HAND_CATEGORIES 9
+
+/**
+ * Counts the live pairs of hole cards on a board of three to five cards by
+ * the category of the hand they make with it, and returns the number of
+ * live pairs. A pair is live if neither card is on the board or dead.
+ *
+ * The pairs are not evaluated one by one. Without a flush, the category
+ * only depends on the two ranks, so each of the 91 pairs of ranks is
+ * categorized once from the rank masks of the board, and weighted by the
+ * number of live cards of its ranks. The pairs that complete a flush in
+ * the one suit that can have one are then moved to the flush or straight
+ * flush category, grouped by their ranks in that suit.
+ */
+int CountCategories(const Hand &board, CardSet dead,
+                    int counts[NUM_HAND_CATEGORIES]);
+
+#endif /* HOLDEM_BOARD_H */
@@ -0,0 +1,49 @@
+#include "combo.h"
+#include <algorithm>
+
+const ComboTables& GetComboTables()
+{
+    static const ComboTables tables = []()
+    {
+        ComboTables t;
+        for (int b = 1; b < 52; b++)
+        {
+            for (int a = 0; a < b; a++)
+            {
+                int combo = b * (b - 1) / 2 + a;
+                Card ca((Rank)(a % 13), (Suit)(a / 13));
+                Card cb((Rank)(b % 13), (Suit)(b / 13));
+                t.hands[combo] = Hand(ca) + Hand(cb);
+
+                int r1 = std::min(ca.rank, cb.rank);
+                int r2 = std::max(ca.rank, cb.rank);
+                t.classes[combo] = (uint8_t)((ca.suit == cb.suit)?
+                    r2 * 13 + r1 : r1 * 13 + r2);
+            }
+        }
+
+        // Sort the combos by class with a counting sort.
+        int count[NUM_HOLE_CLASSES] = { 0 };
+        for (int i = 0; i < NUM_COMBOS; i++)
+            ++count[t.classes[i]];
+        t.class_begin[0] = 0;
+        for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+            t.class_begin[c + 1] = (uint16_t)(t.class_begin[c] + count[c]);
+        int next[NUM_HOLE_CLASSES];
+        for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+            next[c] = t.class_begin[c];
+        for (int i = 0; i < NUM_COMBOS; i++)
+            t.class_combos[next[t.classes[i]]++] = (uint16_t)i;
+        return t;
+    }();
+    return tables;
+}
+
+void FormatHoleClass(char s[4], int hole_class)
+{
+    int r1 = hole_class / 13, r2 = hole_class % 13;
+    s[0] = format_rank((Rank)std::max(r1, r2));
+    s[1] = format_rank((Rank)std::min(r1, r2));
+    s[2] = (r1 == r2)? ' ' : (r1 > r2)? 's' : 'o';
+    s[3] = 0;
+}
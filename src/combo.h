@@ -0,0 +1,87 @@
+#ifndef HOLDEM_COMBO_H
+#define HOLDEM_COMBO_H
+
+#include "hand.h"
+#include "intrinsic.hpp"
+
+/// Number of distinct pairs of hole cards.
+#define NUM_COMBOS 1326
+
+/// Number of classes of hole cards, such as "AKs", up to suit renaming.
+#define NUM_HOLE_CLASSES 169
+
+/**
+ * Maps between the representations of two hole cards, so that ranges,
+ * matrices and statistics share one key space:
+ *
+ *   - the combo index in [0, 1326);
+ *   - the class index in [0, 169), numbered as follows:
+ *       23s, 23o, 24s, 24o, ..., 2As, 2Ao
+ *       34s, 34o, 35s, 35o, ..., 3As, 3Ao
+ *       ...
+ *       KAs, KAo
+ *       22, 33, ..., AA
+ *     i.e. for ranks r1 <= r2, a pair or an offsuit hand has index
+ *     r1*13+r2, and a suited hand has index r2*13+r1;
+ *   - the Hand holding the two cards.
+ *
+ * Each card is numbered suit*13+rank, which is its bit position in
+ * Hand::value with the three counter bits of each lower suit removed, and
+ * the combo of the cards a < b has index b*(b-1)/2+a. The index of a Hand
+ * thus takes two bit scans and a few shifts, without any loop.
+ */
+struct ComboTables
+{
+    Hand hands[NUM_COMBOS];					/* the cards of each combo */
+    uint8_t classes[NUM_COMBOS];			/* the class of each combo */
+    uint16_t class_combos[NUM_COMBOS];		/* combos sorted by class */
+    uint16_t class_begin[NUM_HOLE_CLASSES + 1]; /* range of each class */
+};
+
+/// Returns the tables of the combos, building them on first use.
+const ComboTables& GetComboTables();
+
+/// Returns the combo index of a hand of exactly two cards.
+inline int GetComboIndex(const Hand &hole)
+{
+    uint64_t v = hole.GetCardSet();
+    int a = intrinsic::bit_scan_forward(v);
+    int b = intrinsic::bit_scan_reverse(v);
+    a -= 3 * (a >> 4);
+    b -= 3 * (b >> 4);
+    return b * (b - 1) / 2 + a;
+}
+
+/// Returns the two cards of a combo.
+inline Hand GetComboHand(int combo)
+{
+    return GetComboTables().hands[combo];
+}
+
+/// Returns the class index of a combo.
+inline int GetComboClass(int combo)
+{
+    return GetComboTables().classes[combo];
+}
+
+/// Returns the class index of a hand of exactly two cards.
+inline int GetHoleClass(const Hand &hole)
+{
+    return GetComboClass(GetComboIndex(hole));
+}
+
+/**
+ * Returns the number of combos in a class (6 for a pair, 4 if suited, 12
+ * if offsuit), and stores a pointer to their indices in combos.
+ */
+inline int GetClassCombos(int hole_class, const uint16_t **combos)
+{
+    const ComboTables &t = GetComboTables();
+    *combos = &t.class_combos[t.class_begin[hole_class]];
+    return t.class_begin[hole_class + 1] - t.class_begin[hole_class];
+}
+
+/// Formats a class index such as "AKs", "AKo" or "AA ".
+void FormatHoleClass(char s[4], int hole_class);
+
+#endif /* HOLDEM_COMBO_H */
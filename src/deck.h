@@ -0,0 +1,91 @@
+#ifndef HOLDEM_DECK_H
+#define HOLDEM_DECK_H
+
+#include "hand.h"
+#include <random>
+#include <utility>
+
+/**
+ * Represents the live cards of a deck, i.e. the cards that are not held by
+ * any player, not on the board, and not known to be dead.
+ *
+ * Each card is stored as a single-card Hand so that a deal can be turned
+ * into a hand by adding up the cards directly.
+ */
+struct Deck
+{
+    Hand cards[52];
+    int num_cards;
+
+    /// Creates a deck of the 52 cards excluding the given card set.
+    explicit Deck(CardSet excluded = 0) : num_cards(0)
+    {
+        for (int i = 0; i < 52; i++)
+        {
+            Card card((Rank)(i / 4), (Suit)(i % 4));
+            Hand hand(card);
+            if ((hand.value & excluded) == 0)
+                cards[num_cards++] = hand;
+        }
+    }
+
+    /**
+     * Moves k randomly chosen cards to the front of the deck by a partial
+     * Fisher-Yates shuffle. Only k random numbers are drawn, so this is much
+     * cheaper than shuffling the whole deck when only a few cards are dealt.
+     */
+    template <class Engine>
+    void Deal(Engine &engine, int k)
+    {
+        for (int i = 0; i < k; i++)
+        {
+            int j = std::uniform_int_distribution<int>(i, num_cards - 1)(engine);
+            std::swap(cards[i], cards[j]);
+        }
+    }
+};
+
+/**
+ * Invokes f(indices) for every k-combination of {0, 1, ..., n-1}, where
+ * indices is an array of k increasing integers. The combinations are
+ * visited in lexicographical order.
+ */
+template <class Func>
+void ForEachCombination(int n, int k, Func f)
+{
+    int indices[52];
+    for (int i = 0; i < k; i++)
+        indices[i] = i;
+
+    if (k > n)
+        return;
+
+    for (;;)
+    {
+        f((const int *)indices);
+
+        // Find the right-most index that can still be incremented.
+        int i = k - 1;
+        while (i >= 0 && indices[i] == n - k + i)
+            --i;
+        if (i < 0)
+            break;
+
+        ++indices[i];
+        for (int j = i + 1; j < k; j++)
+            indices[j] = indices[j - 1] + 1;
+    }
+}
+
+/// Returns the binomial coefficient C(n, k) as a floating point number.
+inline double Choose(int n, int k)
+{
+    if (k < 0 || k > n)
+        return 0;
+    double c = 1;
+    for (int i = 0; i < k; i++)
+        c = c * (n - i) / (i + 1);
+    return c;
+}
+
+#endif /* HOLDEM_DECK_H */
@@ -0,0 +1,183 @@
+#include "draw.h"
+#include "deck.h"
+#include "parallel.h"
+#include "intrinsic.hpp"
+#include <algorithm>
+
+StrengthDistribution::StrengthDistribution(const std::vector<HandStrength> &samples)
+{
+    std::vector<uint32_t> sorted(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+        sorted[i] = samples[i].value;
+    std::sort(sorted.begin(), sorted.end());
+
+    // Collapse the sorted samples into distinct strengths with the
+    // probability of a weaker and an equal hand.
+    double total = (double)sorted.size();
+    for (size_t i = 0; i < sorted.size(); )
+    {
+        size_t j = i;
+        while (j < sorted.size() && sorted[j] == sorted[i])
+            ++j;
+        values_.push_back(sorted[i]);
+        below_.push_back(i / total);
+        equal_.push_back((j - i) / total);
+        i = j;
+    }
+
+    // Size the hash table to at least twice the number of distinct
+    // strengths, so that most lookups take a single probe.
+    int bits = 4;
+    while ((1U << bits) < 2 * values_.size())
+        ++bits;
+    mask_ = (1U << bits) - 1;
+    shift_ = 32 - bits;
+    Entry empty = { 0, 0.0f };
+    table_.assign(mask_ + 1, empty);
+    for (size_t k = 0; k < values_.size(); k++)
+    {
+        uint32_t i = Hash(values_[k]);
+        while (table_[i].key != 0)
+            i = (i + 1) & mask_;
+        table_[i].key = values_[k];
+        table_[i].prob = (float)(below_[k] + 0.5 * equal_[k]);
+    }
+}
+
+double StrengthDistribution::Search(HandStrength strength) const
+{
+    size_t k = std::lower_bound(values_.begin(), values_.end(), strength.value)
+        - values_.begin();
+    if (k == values_.size())
+        return 1.0;
+    double p = below_[k];
+    if (values_[k] == strength.value)
+        p += 0.5 * equal_[k];
+    return p;
+}
+
+const StrengthDistribution& GetPatHandDistribution()
+{
+    static const StrengthDistribution dist = []()
+    {
+        Deck deck;
+        std::vector<HandStrength> samples;
+        samples.reserve(2598960);
+        ForEachCombination(52, 5, [&](const int *index)
+        {
+            Hand hand;
+            for (int i = 0; i < 5; i++)
+                hand += deck.cards[index[i]];
+            samples.push_back(EvaluateFiveCards(hand));
+        });
+        return StrengthDistribution(samples);
+    }();
+    return dist;
+}
+
+#define DRAW_BATCH_SIZE 256
+
+/**
+ * Invokes f(hand) for the partial hand plus every combination of 'left'
+ * cards from deck.cards[start..]. The partial sums are carried down the
+ * recursion, so each draw costs a single addition.
+ */
+template <class Func>
+static void ForEachDraw(const Deck &deck, int start, int left, Hand partial,
+                        Func &f)
+{
+    if (left == 0)
+    {
+        f(partial);
+        return;
+    }
+    for (int i = start; i <= deck.num_cards - left; i++)
+        ForEachDraw(deck, i + 1, left - 1, partial + deck.cards[i], f);
+}
+
+/// Enumerates the draws for one discard option and fills in its outcome.
+static void EvaluateDiscard(const Card cards[5], const Deck &deck, int keep,
+                            const StrengthDistribution &reference,
+                            DiscardOption &option)
+{
+    Hand kept;
+    for (int i = 0; i < 5; i++)
+    {
+        if (keep & (1 << i))
+            kept += Hand(cards[i]);
+    }
+
+    int num_discards = 5 - intrinsic::pop_count(keep);
+    Hand batch[DRAW_BATCH_SIZE];
+    HandStrength strengths[DRAW_BATCH_SIZE];
+    double count[9] = { 0 };
+    double ev = 0;
+    size_t n = 0;
+
+    // Score a full batch of drawn hands in one pass.
+    auto flush = [&]()
+    {
+        EvaluateFiveCardHands(batch, strengths, n);
+        for (size_t i = 0; i < n; i++)
+        {
+            count[strengths[i].value >> 26] += 1;
+            ev += reference.GetWinProbability(strengths[i]);
+        }
+        n = 0;
+    };
+
+    auto add = [&](const Hand &hand)
+    {
+        batch[n++] = hand;
+        if (n == DRAW_BATCH_SIZE)
+            flush();
+    };
+    ForEachDraw(deck, 0, num_discards, kept, add);
+    flush();
+
+    double total = 0;
+    for (int c = 0; c < 9; c++)
+        total += count[c];
+
+    option.keep = keep;
+    option.num_discards = num_discards;
+    option.num_draws = total;
+
+    // With too few live cards to replace the discards there is no draw at
+    // all; mark the option infeasible rather than divide by zero, which
+    // would leave NaNs for RankDiscards to sort.
+    if (total == 0)
+    {
+        for (int c = 0; c < 9; c++)
+            option.category[c] = 0;
+        option.ev = -1;
+        return;
+    }
+    for (int c = 0; c < 9; c++)
+        option.category[c] = count[c] / total;
+    option.ev = ev / total;
+}
+
+void RankDiscards(const Card cards[5], CardSet dead,
+                  const StrengthDistribution &reference,
+                  DiscardOption options[32])
+{
+    // The live deck excludes our own five cards, including the ones we
+    // throw away, as well as the dead cards.
+    Deck deck(dead | Hand(cards, 5).GetCardSet());
+
+    // Each option is independent; the options that draw many cards cost
+    // by far the most, so interleave them across threads.
+    int num_threads = std::min(GetThreadCount(), 32);
+    ParallelFor(num_threads, num_threads, [&](int thread, int64_t, int64_t)
+    {
+        for (int keep = thread; keep < 32; keep += num_threads)
+            EvaluateDiscard(cards, deck, keep, reference, options[keep]);
+    });
+
+    std::stable_sort(options, options + 32,
+        [](const DiscardOption &a, const DiscardOption &b) -> bool
+    {
+        return a.ev > b.ev;
+    });
+}
@@ -0,0 +1,91 @@
+#ifndef HOLDEM_DRAW_H
+#define HOLDEM_DRAW_H
+
+#include "hand.h"
+#include <vector>
+
+/**
+ * Represents the distribution of the strength of a reference (opponent)
+ * five-card hand, against which draws are scored.
+ *
+ * The distribution is stored as the sorted distinct strengths together
+ * with the probability to beat each one (ties counting half). Since draw
+ * enumeration looks up millions of strengths per query, a small open-
+ * addressing hash table maps each distinct strength to its probability
+ * in O(1); strengths not in the distribution fall back to binary search.
+ */
+class StrengthDistribution
+{
+public:
+    /// Builds the distribution from strength samples given in any order.
+    explicit StrengthDistribution(const std::vector<HandStrength> &samples);
+
+    /// Returns the probability that a hand of the given strength beats a
+    /// hand drawn from the distribution, counting a tie as half a win.
+    double GetWinProbability(HandStrength strength) const
+    {
+        uint32_t i = Hash(strength.value);
+        while (table_[i].key != 0)
+        {
+            if (table_[i].key == strength.value)
+                return table_[i].prob;
+            i = (i + 1) & mask_;
+        }
+        return Search(strength);
+    }
+
+private:
+    uint32_t Hash(uint32_t x) const
+    {
+        return ((x * 0x9E3779B1U) >> shift_) & mask_;
+    }
+
+    double Search(HandStrength strength) const;
+
+    std::vector<uint32_t> values_; // sorted distinct strengths
+    std::vector<double> below_;    // probability of a weaker hand
+    std::vector<double> equal_;    // probability of an equal hand
+
+    struct Entry
+    {
+        uint32_t key;
+        float prob;
+    };
+    std::vector<Entry> table_;
+    uint32_t mask_;
+    int shift_;
+};
+
+/**
+ * Returns the distribution of a pat five-card hand dealt from a full deck.
+ * The distribution is built on first use and cached.
+ */
+const StrengthDistribution& GetPatHandDistribution();
+
+/**
+ * Represents the outcome of one way to discard from a five-card hand.
+ *
+ * If the live deck holds fewer cards than num_discards, the option is
+ * infeasible: num_draws is 0, every category is 0 and ev is -1, so that
+ * it sorts after every feasible option.
+ */
+struct DiscardOption
+{
+    int keep;              /* bit i is set if card i of the hand is kept */
+    int num_discards;      /* number of cards thrown and replaced */
+    double num_draws;      /* number of distinct replacement draws */
+    double category[9];    /* probability of each final hand category */
+    double ev;             /* probability to beat the reference hand, or -1 */
+};
+
+/**
+ * Evaluates all 32 ways to discard from a five-card hand by enumerating
+ * every replacement draw from the live deck (the 47 unseen cards less the
+ * dead cards), and sorts the options by EV against the reference, best
+ * first. Each draw is scored with the five-card fast path in batches.
+ */
+void RankDiscards(const Card cards[5], CardSet dead,
+                  const StrengthDistribution &reference,
+                  DiscardOption options[32]);
+
+#endif /* HOLDEM_DRAW_H */
@@ -0,0 +1,722 @@
+#include "equity.h"
+#include "arena.h"
+#include "board.h"
+#include "combo.h"
+#include "deck.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+
+/// Accumulates the two-board showdown results of one thread.
+struct DoubleBoardTally
+{
+    double board[2][MAX_EQUITY_PLAYERS];
+    double scoop[MAX_EQUITY_PLAYERS];
+    double split[MAX_EQUITY_PLAYERS];
+    double num_deals;
+
+    DoubleBoardTally() : num_deals(0)
+    {
+        for (int i = 0; i < MAX_EQUITY_PLAYERS; i++)
+            board[0][i] = board[1][i] = scoop[i] = split[i] = 0;
+    }
+
+    void Merge(const DoubleBoardTally &a)
+    {
+        for (int i = 0; i < MAX_EQUITY_PLAYERS; i++)
+        {
+            board[0][i] += a.board[0][i];
+            board[1][i] += a.board[1][i];
+            scoop[i] += a.scoop[i];
+            split[i] += a.split[i];
+        }
+        num_deals += a.num_deals;
+    }
+};
+
+/// Settles both boards and records the result in the tally.
+static void Showdown(const DoubleBoardHand &hand, const Hand boards[2],
+                     DoubleBoardTally &tally)
+{
+    int n = hand.num_players;
+    double share[2][MAX_EQUITY_PLAYERS];
+    for (int b = 0; b < 2; b++)
+    {
+        BoardContext board(boards[b]);
+        uint32_t winners = ResolveShowdown(board, hand.holes, n, NULL);
+        int num_winners = intrinsic::pop_count(winners);
+        for (int i = 0; i < n; i++)
+            share[b][i] = ((winners >> i) & 1)? 1.0 / num_winners : 0.0;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        tally.board[0][i] += share[0][i];
+        tally.board[1][i] += share[1][i];
+        double total = 0.5 * (share[0][i] + share[1][i]);
+        if (total == 1.0)
+            tally.scoop[i] += 1;
+        else if (total > 0)
+            tally.split[i] += 1;
+    }
+    tally.num_deals += 1;
+}
+
+/// Computes the number of cards missing from each board and the cards that
+/// are out of the deck. Returns false if the hand is invalid.
+static bool GetCardsToDeal(const DoubleBoardHand &hand, int need[2],
+                           CardSet &known)
+{
+    if (hand.num_players < 2 || hand.num_players > MAX_EQUITY_PLAYERS)
+        return false;
+
+    known = hand.dead;
+    for (int i = 0; i < hand.num_players; i++)
+    {
+        if (hand.holes[i].GetCardCount() != 2 ||
+            (known & hand.holes[i].GetCardSet()) != 0)
+            return false;
+        known |= hand.holes[i].GetCardSet();
+    }
+    for (int b = 0; b < 2; b++)
+    {
+        int n = hand.boards[b].GetCardCount();
+        if (n > 5 || (known & hand.boards[b].GetCardSet()) != 0)
+            return false;
+        need[b] = 5 - n;
+    }
+
+    // The boards either share all their known cards (running it twice) or
+    // none of them (double board).
+    CardSet shared = hand.boards[0].GetCardSet() & hand.boards[1].GetCardSet();
+    if (shared != 0 && hand.boards[0].value != hand.boards[1].value)
+        return false;
+
+    known |= hand.boards[0].GetCardSet() | hand.boards[1].GetCardSet();
+    return need[0] + need[1] <= Deck(known).num_cards;
+}
+
+static void FinishResult(const DoubleBoardTally &tally, int num_players,
+                         DoubleBoardEquity *result)
+{
+    for (int i = 0; i < num_players; i++)
+    {
+        result[i].board[0] = tally.board[0][i] / tally.num_deals;
+        result[i].board[1] = tally.board[1][i] / tally.num_deals;
+        result[i].scoop = tally.scoop[i] / tally.num_deals;
+        result[i].split = tally.split[i] / tally.num_deals;
+        result[i].equity = 0.5 * (result[i].board[0] + result[i].board[1]);
+    }
+}
+
+double CountDoubleBoardDeals(const DoubleBoardHand &hand)
+{
+    int need[2];
+    CardSet known;
+    if (!GetCardsToDeal(hand, need, known))
+        return 0;
+
+    int n = Deck(known).num_cards;
+    return Choose(n, need[0]) * Choose(n - need[0], need[1]);
+}
+
+bool EnumerateDoubleBoardEquity(const DoubleBoardHand &hand,
+                                DoubleBoardEquity *result)
+{
+    int need[2];
+    CardSet known;
+    if (!GetCardsToDeal(hand, need, known))
+        return false;
+
+    // List the runouts of the first board, and let each thread enumerate
+    // the runouts of the second board for a slice of the list.
+    ArenaScope scope;
+    Deck deck(known);
+    Hand *runouts = scope.New<Hand>((size_t)Choose(deck.num_cards, need[0]));
+    int64_t num_runouts = 0;
+    ForEachCombination(deck.num_cards, need[0], [&](const int *index)
+    {
+        Hand runout;
+        for (int i = 0; i < need[0]; i++)
+            runout += deck.cards[index[i]];
+        runouts[num_runouts++] = runout;
+    });
+
+    int num_threads = GetThreadCount();
+    DoubleBoardTally *tallies = scope.New<DoubleBoardTally>(num_threads);
+    ParallelFor(num_runouts, num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        Hand rest[52];
+        Hand boards[2];
+        for (int64_t k = begin; k < end; k++)
+        {
+            int num_rest = 0;
+            for (int i = 0; i < deck.num_cards; i++)
+            {
+                if ((deck.cards[i].value & runouts[k].GetCardSet()) == 0)
+                    rest[num_rest++] = deck.cards[i];
+            }
+
+            boards[0] = hand.boards[0] + runouts[k];
+            ForEachCombination(num_rest, need[1], [&](const int *index)
+            {
+                boards[1] = hand.boards[1];
+                for (int i = 0; i < need[1]; i++)
+                    boards[1] += rest[index[i]];
+                Showdown(hand, boards, tallies[thread]);
+            });
+        }
+    });
+
+    DoubleBoardTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+    FinishResult(total, hand.num_players, result);
+    return true;
+}
+
+bool SimulateDoubleBoardEquity(const DoubleBoardHand &hand, int num_trials,
+                               unsigned int seed, DoubleBoardEquity *result)
+{
+    int need[2];
+    CardSet known;
+    if (!GetCardsToDeal(hand, need, known) || num_trials <= 0)
+        return false;
+
+    ArenaScope scope;
+    int num_threads = GetThreadCount();
+    DoubleBoardTally *tallies = scope.New<DoubleBoardTally>(num_threads);
+    ParallelFor(num_trials, num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        std::mt19937 engine(seed + thread);
+        Deck deck(known);
+        Hand boards[2];
+        for (int64_t k = begin; k < end; k++)
+        {
+            deck.Deal(engine, need[0] + need[1]);
+            boards[0] = hand.boards[0];
+            for (int i = 0; i < need[0]; i++)
+                boards[0] += deck.cards[i];
+            boards[1] = hand.boards[1];
+            for (int i = 0; i < need[1]; i++)
+                boards[1] += deck.cards[need[0] + i];
+            Showdown(hand, boards, tallies[thread]);
+        }
+    });
+
+    DoubleBoardTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+    FinishResult(total, hand.num_players, result);
+    return true;
+}
+
+/**
+ * Exact equity of each class of hole cards against one random hand, with 
+ * ties counted as half, indexed by class (see combo.h): pairs
+ * on the diagonal, suited hands below it and offsuit hands above it. The
+ * table was computed offline by sweeping all 2,598,960 boards: for each
+ * board the 1,081 hole card combinations are ranked, and the opponents 
+ * that share a card with the hero are removed by inclusion-exclusion over
+ * the combinations that contain each card.
+ */
+static const double PreflopHeadsUpEquity[169] =
+{
+    0.5033402, 0.3230323, 0.3319975, 0.3428465, 0.3407514, 0.3458365, 0.3682767, 0.3909794, 0.4166835, 0.4434847, 0.4729544, 0.5050872, 0.5492856,
+    0.3598443, 0.5369308, 0.3514589, 0.3626477, 0.3607763, 0.3660226, 0.3748381, 0.4001951, 0.4259455, 0.4527554, 0.4821944, 0.5142569, 0.5584460,
+    0.3682901, 0.3864195, 0.5702282, 0.3815529, 0.3801049, 0.3854983, 0.3944679, 0.4067105, 0.4350411, 0.4618638, 0.4912768, 0.5232747, 0.5672968,
+    0.3784933, 0.3969296, 0.4145342, 0.6032492, 0.3994430, 0.4051197, 0.4142753, 0.4266914, 0.4425095, 0.4718089, 0.5012008, 0.5331397, 0.5769653,
+    0.3766896, 0.3953356, 0.4133332, 0.4313339, 0.6328475, 0.4232275, 0.4324090, 0.4449135, 0.4609200, 0.4784427, 0.5102405, 0.5422328, 0.5768245,
+    0.3815589, 0.4003594, 0.4184931, 0.4367554, 0.4537177, 0.6623602, 0.4505081, 0.4629781, 0.4790814, 0.4968193, 0.5176567, 0.5518735, 0.5884120,
+    0.4027163, 0.4087350, 0.4270163, 0.4454499, 0.4624327, 0.4793634, 0.6916304, 0.4809703, 0.4972127, 0.5149016, 0.5359979, 0.5602017, 0.5987261,
+    0.4241517, 0.4326426, 0.4386197, 0.4572187, 0.4742829, 0.4911773, 0.5080076, 0.7205725, 0.5153167, 0.5325120, 0.5536043, 0.5781192, 0.6077281,
+    0.4483948, 0.4569251, 0.4653049, 0.4721626, 0.4894068, 0.5063904, 0.5233437, 0.5402753, 0.7501178, 0.5524770, 0.5729078, 0.5973892, 0.6272165,
+    0.4737815, 0.4823162, 0.4907045, 0.4998685, 0.5060591, 0.5232478, 0.5401564, 0.5566247, 0.5752786, 0.7746947, 0.5813469, 0.6056869, 0.6356326,
+    0.5016904, 0.5101925, 0.5185530, 0.5276941, 0.5361257, 0.5430226, 0.5601773, 0.5766432, 0.5946756, 0.6025921, 0.7992516, 0.6145580, 0.6443184,
+    0.5321173, 0.5405498, 0.5488464, 0.5579292, 0.5664074, 0.5753774, 0.5831235, 0.5998848, 0.6178856, 0.6256734, 0.6340040, 0.8239568, 0.6532007,
+    0.5737890, 0.5822032, 0.5903364, 0.5992293, 0.5990583, 0.6098396, 0.6194381, 0.6278121, 0.6460239, 0.6539268, 0.6620886, 0.6704463, 0.8520371
+};
+
+bool ComputeHeadsUpEquity(const Hand &hero, const Hand &board, CardSet dead,
+                          double &equity)
+{
+    int num_board = board.GetCardCount();
+    if (hero.GetCardCount() != 2)
+        return false;
+    if (num_board == 0 && dead == 0)
+    {
+        equity = PreflopHeadsUpEquity[GetHoleClass(hero)];
+        return true;
+    }
+    if (num_board < 3 || num_board > 5)
+        return false;
+
+    Deck deck(dead | hero.GetCardSet() | board.GetCardSet());
+    double total = 0, count = 0;
+    ForEachCombination(deck.num_cards, 5 - num_board, [&](const int *index)
+    {
+        Hand full_board = board;
+        for (int i = 0; i < 5 - num_board; i++)
+            full_board += deck.cards[index[i]];
+        CardSet runout = full_board.GetCardSet();
+
+        BoardContext context(full_board);
+        HandStrength hero_strength = context.Evaluate(hero);
+        ForEachCombination(deck.num_cards, 2, [&](const int *pair)
+        {
+            Hand opponent = deck.cards[pair[0]] + deck.cards[pair[1]];
+            if (opponent.GetCardSet() & runout)
+                return;
+            HandStrength strength = context.Evaluate(opponent);
+            total += (hero_strength > strength)? 1.0 : 
+                     (hero_strength == strength)? 0.5 : 0.0;
+            count += 1;
+        });
+    });
+    if (count == 0)
+        return false;
+    equity = total / count;
+    return true;
+}
+
+/// Accumulates the units of an equity estimate in one thread.
+struct EstimateTally
+{
+    double sum;			/* sum of the unit means */
+    double sum_squares;	/* sum of the squared unit means */
+    double deal_sum_squares;	/* sum of the squared shares of each deal */
+    double control_sum;			/* sum of the unit means of the control */
+    double control_squares;		/* sum of their squares */
+    double cross_products;		/* sum of the unit means times the control */
+    int64_t num_units;
+    int64_t num_deals;
+
+    EstimateTally() 
+        : sum(0), sum_squares(0), deal_sum_squares(0), control_sum(0), 
+          control_squares(0), cross_products(0), num_units(0), num_deals(0) { }
+
+    void Merge(const EstimateTally &a)
+    {
+        sum += a.sum;
+        sum_squares += a.sum_squares;
+        deal_sum_squares += a.deal_sum_squares;
+        control_sum += a.control_sum;
+        control_squares += a.control_squares;
+        cross_products += a.cross_products;
+        num_units += a.num_units;
+        num_deals += a.num_deals;
+    }
+};
+
+bool EstimateEquity(const Hand &hero, const Hand &board, CardSet dead,
+                    int num_opponents, int num_trials, SamplingMode mode,
+                    unsigned int seed, EquityEstimate &result,
+                    bool use_control)
+{
+    const int num_replicates = 16;
+
+    int num_board = board.GetCardCount();
+    CardSet known = dead | hero.GetCardSet() | board.GetCardSet();
+    if (hero.GetCardCount() != 2 || num_board > 5 || num_opponents < 1 ||
+        num_opponents >= MAX_EQUITY_PLAYERS || num_trials <= 0 ||
+        (hero.GetCardSet() & (dead | board.GetCardSet())) != 0 ||
+        (board.GetCardSet() & dead) != 0)
+        return false;
+
+    Deck deck(known);
+    int k = (5 - num_board) + 2 * num_opponents;
+    if (k > deck.num_cards || (mode == Sampling_Sobol && k > MAX_SOBOL_DIMENSIONS))
+        return false;
+
+    // A unit is the smallest group of deals that is independent of the 
+    // other groups.
+    int64_t num_units, deals_per_unit;
+    if (mode == Sampling_Sobol)
+    {
+        num_units = num_replicates;
+        deals_per_unit = std::max(num_trials / num_replicates, 1);
+    }
+    else if (mode == Sampling_Antithetic)
+    {
+        num_units = std::max(num_trials / 2, 1);
+        deals_per_unit = 2;
+    }
+    else
+    {
+        num_units = num_trials;
+        deals_per_unit = 1;
+    }
+
+    // The expectation of the control is free from the preflop table, and
+    // otherwise worth enumerating only if that takes no more evaluations
+    // than the deals, each of which evaluates the hero and every opponent.
+    if (use_control && !(num_board == 0 && dead == 0))
+    {
+        int m = 5 - num_board;
+        double control_cost = Choose(deck.num_cards, m) * 
+                              (1 + Choose(deck.num_cards - m, 2));
+        double deal_cost = (double)(num_units * deals_per_unit) * (1 + num_opponents);
+        use_control = (control_cost <= deal_cost);
+    }
+
+    ArenaScope scope;
+    int num_threads = GetThreadCount();
+    EstimateTally *tallies = scope.New<EstimateTally>(num_threads);
+    ParallelFor(num_units, num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        EstimateTally &tally = tallies[thread];
+        Hand cards[52];
+        Hand holes[MAX_EQUITY_PLAYERS];
+        holes[0] = hero;
+
+        // Sobol replicates each need their own sequence; the other modes 
+        // can run all their units from one sampler per thread.
+        DealSampler sampler(mode, k, seed + (uint32_t)thread);
+        for (int64_t u = begin; u < end; u++)
+        {
+            if (mode == Sampling_Sobol)
+                sampler = DealSampler(mode, k, seed + (uint32_t)u);
+
+            double unit_sum = 0, unit_control = 0;
+            for (int64_t d = 0; d < deals_per_unit; d++)
+            {
+                sampler.Deal(deck, cards);
+                Hand full_board = board;
+                for (int i = 0; i < 5 - num_board; i++)
+                    full_board += cards[i];
+                for (int i = 0; i < num_opponents; i++)
+                    holes[1 + i] = cards[5 - num_board + 2 * i] + 
+                                   cards[5 - num_board + 2 * i + 1];
+                BoardContext context(full_board);
+
+                double share;
+                if (use_control)
+                {
+                    // Every opponent is evaluated, since the heads-up 
+                    // shares need them all.
+                    HandStrength hero_strength = context.Evaluate(hero);
+                    int num_better = 0, num_tied = 0;
+                    for (int i = 0; i < num_opponents; i++)
+                    {
+                        HandStrength strength = context.Evaluate(holes[1 + i]);
+                        num_better += (strength > hero_strength);
+                        num_tied += (strength == hero_strength);
+                    }
+                    share = (num_better == 0)? 1.0 / (1 + num_tied) : 0.0;
+                    unit_control += (num_opponents - num_better - 0.5 * num_tied) /
+                                    num_opponents;
+                }
+                else
+                {
+                    uint32_t winners = ResolveShowdown(context, holes, 
+                                                       num_opponents + 1, NULL);
+                    share = (winners & 1)? 1.0 / intrinsic::pop_count(winners) : 0.0;
+                }
+                unit_sum += share;
+                tally.deal_sum_squares += share * share;
+            }
+
+            double unit_mean = unit_sum / deals_per_unit;
+            tally.sum += unit_mean;
+            tally.sum_squares += unit_mean * unit_mean;
+            if (use_control)
+            {
+                double control_mean = unit_control / deals_per_unit;
+                tally.control_sum += control_mean;
+                tally.control_squares += control_mean * control_mean;
+                tally.cross_products += unit_mean * control_mean;
+            }
+            tally.num_units++;
+            tally.num_deals += deals_per_unit;
+        }
+    });
+
+    EstimateTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+
+    double n = (double)total.num_units;
+    double mean = total.sum / n;
+    double unit_variance = (n > 1)? 
+        std::max(total.sum_squares - n * mean * mean, 0.0) / (n - 1) : 0.0;
+    double deal_variance = std::max(
+        total.deal_sum_squares / total.num_deals - mean * mean, 0.0);
+
+    result.equity = mean;
+    result.std_error = std::sqrt(unit_variance / n);
+    result.deal_variance = deal_variance;
+    result.variance_reduction = (unit_variance > 0)? 
+        (deal_variance / total.num_deals) / (unit_variance / n) : 0.0;
+    result.num_deals = total.num_deals;
+
+    result.has_control = use_control &&
+        ComputeHeadsUpEquity(hero, board, dead, result.control_mean);
+
+    // Fit the control by least squares on the units. The residual 
+    // variance has two degrees of freedom fewer than the units.
+    if (!result.has_control)
+        result.control_mean = 0;
+    result.adjusted_equity = result.equity;
+    result.adjusted_std_error = result.std_error;
+    if (result.has_control && n > 2)
+    {
+        double control_mean = total.control_sum / n;
+        double scc = total.control_squares - n * control_mean * control_mean;
+        double sxc = total.cross_products - n * mean * control_mean;
+        double sxx = total.sum_squares - n * mean * mean;
+        double beta = (scc > 0)? sxc / scc : 0.0;
+        double residual = std::max(sxx - beta * sxc, 0.0) / (n - 2);
+        result.adjusted_equity = mean - beta * (control_mean - result.control_mean);
+        result.adjusted_std_error = std::sqrt(residual / n);
+    }
+    return true;
+}
+
+/// Accumulates the shares of each player over the runouts of one thread.
+struct TimedTally
+{
+    double sum[MAX_EQUITY_PLAYERS];
+    double sum_squares[MAX_EQUITY_PLAYERS];
+    int64_t num_deals;
+
+    TimedTally() : num_deals(0)
+    {
+        for (int i = 0; i < MAX_EQUITY_PLAYERS; i++)
+            sum[i] = sum_squares[i] = 0;
+    }
+
+    void Merge(const TimedTally &a)
+    {
+        for (int i = 0; i < MAX_EQUITY_PLAYERS; i++)
+        {
+            sum[i] += a.sum[i];
+            sum_squares[i] += a.sum_squares[i];
+        }
+        num_deals += a.num_deals;
+    }
+
+    void Showdown(const Hand &board, const Hand *holes, int num_players)
+    {
+        BoardContext context(board);
+        uint32_t winners = ResolveShowdown(context, holes, num_players, NULL);
+        double share = 1.0 / intrinsic::pop_count(winners);
+        for (int i = 0; i < num_players; i++)
+        {
+            if ((winners >> i) & 1)
+            {
+                sum[i] += share;
+                sum_squares[i] += share * share;
+            }
+        }
+        num_deals++;
+    }
+};
+
+bool ComputeEquityByDeadline(const Hand *holes, int num_players,
+                             const Hand &board, CardSet dead,
+                             std::chrono::steady_clock::time_point deadline,
+                             unsigned int seed, TimedEquity &result)
+{
+    typedef std::chrono::steady_clock clock;
+    const int batch_size = 256;
+
+    int num_board = board.GetCardCount();
+    if (num_players < 2 || num_players > MAX_EQUITY_PLAYERS || num_board > 5 ||
+        (board.GetCardSet() & dead) != 0)
+        return false;
+    CardSet known = dead | board.GetCardSet();
+    for (int i = 0; i < num_players; i++)
+    {
+        if (holes[i].GetCardCount() != 2 || (known & holes[i].GetCardSet()) != 0)
+            return false;
+        known |= holes[i].GetCardSet();
+    }
+
+    Deck deck(known);
+    int need = 5 - num_board;
+    if (need > deck.num_cards)
+        return false;
+    double num_runouts = Choose(deck.num_cards, need);
+
+    // Warm up with one batch of random runouts to measure the cost of a
+    // showdown, which varies with the number of players and the board.
+    TimedTally warmup;
+    clock::time_point start = clock::now();
+    {
+        std::mt19937 engine(seed);
+        Deck d = deck;
+        for (int k = 0; k < batch_size; k++)
+        {
+            d.Deal(engine, need);
+            warmup.Showdown(board + Hand(d.cards, need), holes, num_players);
+        }
+    }
+    clock::time_point now = clock::now();
+    double seconds_per_deal = 
+        std::chrono::duration<double>(now - start).count() / batch_size;
+    double seconds_left = std::chrono::duration<double>(deadline - now).count();
+
+    ArenaScope scope;
+    int num_threads = GetThreadCount();
+    TimedTally *tallies = scope.New<TimedTally>(num_threads);
+    bool exact = false;
+    bool enumerate = (num_runouts * seconds_per_deal <= seconds_left * num_threads);
+    if (enumerate)
+    {
+        // Enumerate the runouts in random order; the threads take batches
+        // from a shared counter until the list is done or time is up. 
+        Hand *runouts = scope.New<Hand>((size_t)num_runouts);
+        int64_t count = 0;
+        ForEachCombination(deck.num_cards, need, [&](const int *index)
+        {
+            Hand runout;
+            for (int i = 0; i < need; i++)
+                runout += deck.cards[index[i]];
+            runouts[count++] = runout;
+        });
+        std::mt19937 engine(seed);
+        for (size_t i = (size_t)count; i > 1; i--)
+        {
+            size_t j = std::uniform_int_distribution<size_t>(0, i - 1)(engine);
+            std::swap(runouts[i - 1], runouts[j]);
+        }
+
+        std::atomic<int64_t> next(0);
+        ParallelFor(num_threads, num_threads, [&](int thread, int64_t, int64_t)
+        {
+            for (;;)
+            {
+                int64_t begin = next.fetch_add(batch_size);
+                if (begin >= count)
+                    break;
+                int64_t end = std::min(begin + batch_size, count);
+                for (int64_t k = begin; k < end; k++)
+                    tallies[thread].Showdown(board + runouts[k], holes, num_players);
+                if (clock::now() >= deadline)
+                    break;
+            }
+        });
+
+        int64_t num_done = 0;
+        for (int t = 0; t < num_threads; t++)
+            num_done += tallies[t].num_deals;
+        exact = (num_done == count);
+    }
+    else
+    {
+        // Deal random runouts until the deadline; the warm-up batch counts.
+        tallies[0] = warmup;
+        ParallelFor(num_threads, num_threads, [&](int thread, int64_t, int64_t)
+        {
+            std::mt19937 engine(seed + 1 + thread);
+            Deck d = deck;
+            while (clock::now() < deadline)
+            {
+                for (int k = 0; k < batch_size; k++)
+                {
+                    d.Deal(engine, need);
+                    tallies[thread].Showdown(board + Hand(d.cards, need), 
+                                             holes, num_players);
+                }
+            }
+        });
+    }
+
+    TimedTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+
+    // Sampling without replacement from the list of runouts shrinks the
+    // variance by the finite population correction.
+    double n = (double)total.num_deals;
+    double correction = 1.0;
+    if (enumerate)
+        correction = exact? 0.0 : (num_runouts - n) / (num_runouts - 1);
+    for (int i = 0; i < num_players; i++)
+    {
+        double mean = total.sum[i] / n;
+        double variance = (n > 1)? 
+            std::max(total.sum_squares[i] - n * mean * mean, 0.0) / (n - 1) : 0.0;
+        result.equity[i] = mean;
+        result.std_error[i] = std::sqrt(variance / n * correction);
+    }
+    result.num_deals = total.num_deals;
+    result.num_runouts = (int64_t)num_runouts;
+    result.exact = exact;
+    return true;
+}
+
+bool EnumeratePotShares(const Hand *holes, int num_players, const Hand &board,
+                        CardSet dead, const uint32_t *pot_players, int num_pots,
+                        double *shares)
+{
+    int num_board = board.GetCardCount();
+    if (num_players < 1 || num_players > MAX_EQUITY_PLAYERS || num_board > 5 ||
+        (board.GetCardSet() & dead) != 0)
+        return false;
+    CardSet known = dead | board.GetCardSet();
+    for (int i = 0; i < num_players; i++)
+    {
+        if (holes[i].GetCardCount() != 2 || (known & holes[i].GetCardSet()) != 0)
+            return false;
+        known |= holes[i].GetCardSet();
+    }
+    Deck deck(known);
+    int need = 5 - num_board;
+    if (need > deck.num_cards)
+        return false;
+
+    for (int k = 0; k < num_pots * num_players; k++)
+        shares[k] = 0;
+
+    double num_runouts = 0;
+    HandStrength strengths[MAX_EQUITY_PLAYERS];
+    ForEachCombination(deck.num_cards, need, [&](const int *index)
+    {
+        Hand full_board = board;
+        for (int i = 0; i < need; i++)
+            full_board += deck.cards[index[i]];
+
+        BoardContext context(full_board);
+        for (int i = 0; i < num_players; i++)
+            strengths[i] = context.Evaluate(holes[i]);
+
+        for (int k = 0; k < num_pots; k++)
+        {
+            HandStrength best;
+            uint32_t winners = 0;
+            for (int i = 0; i < num_players; i++)
+            {
+                if (((pot_players[k] >> i) & 1) == 0)
+                    continue;
+                if (winners == 0 || strengths[i] > best)
+                {
+                    best = strengths[i];
+                    winners = 1U << i;
+                }
+                else if (strengths[i] == best)
+                {
+                    winners |= 1U << i;
+                }
+            }
+            if (winners == 0)
+                continue;
+            double share = 1.0 / intrinsic::pop_count(winners);
+            for (int i = 0; i < num_players; i++)
+            {
+                if ((winners >> i) & 1)
+                    shares[k * num_players + i] += share;
+            }
+        }
+        num_runouts += 1;
+    });
+
+    for (int k = 0; k < num_pots * num_players; k++)
+        shares[k] /= num_runouts;
+    return true;
+}
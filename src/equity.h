@@ -0,0 +1,170 @@
+#ifndef HOLDEM_EQUITY_H
+#define HOLDEM_EQUITY_H
+
+#include "hand.h"
+#include "sampling.h"
+#include <chrono>
+
+#define MAX_EQUITY_PLAYERS 10
+
+/**
+ * Describes a hold'em all-in that is settled on two boards, each board
+ * deciding half of the pot.
+ *
+ * To run it twice, set both boards to the cards already dealt; the missing
+ * cards of the two runouts are then dealt from the same deck, so the second
+ * runout never reuses a card of the first. For a double-board game, set
+ * each board to its own known cards.
+ */
+struct DoubleBoardHand
+{
+    const Hand *holes;	/* hole cards of each player */
+    int num_players;
+    Hand boards[2];		/* known cards of each board (0 to 5) */
+    CardSet dead;		/* cards known to be out of play */
+};
+
+/// Represents the outcome of a two-board showdown for one player.
+struct DoubleBoardEquity
+{
+    double board[2];	/* expected share of each board's half */
+    double scoop;		/* probability of taking both halves alone */
+    double split;		/* probability of taking part of the pot only */
+    double equity;		/* expected share of the whole pot */
+};
+
+/**
+ * Returns the number of distinct pairs of runouts, i.e. the amount of work
+ * for EnumerateDoubleBoardEquity.
+ */
+double CountDoubleBoardDeals(const DoubleBoardHand &hand);
+
+/**
+ * Computes the exact equity of each player by enumerating every pair of
+ * disjoint runouts. Returns false if the hand is invalid.
+ */
+bool EnumerateDoubleBoardEquity(const DoubleBoardHand &hand,
+                                DoubleBoardEquity *result);
+
+/**
+ * Estimates the equity of each player from num_trials random pairs of
+ * runouts. Each trial deals the missing cards of both boards in one
+ * partial shuffle, so the runouts are correlated through card removal
+ * exactly as at the table. Returns false if the hand is invalid.
+ */
+bool SimulateDoubleBoardEquity(const DoubleBoardHand &hand, int num_trials,
+                               unsigned int seed, DoubleBoardEquity *result);
+
+/**
+ * Represents a Monte Carlo estimate of equity together with its precision.
+ *
+ * Every mode of sampling deals each runout with the right probability, so
+ * the variance of a single deal is the same whatever the mode; the modes
+ * only differ in how much the deals cancel out. variance_reduction is the
+ * variance of the mean of independent deals divided by the variance of the
+ * estimate actually obtained with the same number of deals, i.e. how many
+ * times fewer deals the mode needs for the same confidence.
+ *
+ * On request, the estimate is also adjusted by a control variate: the
+ * hero's average heads-up share against each opponent on the same deal. It
+ * is strongly correlated with the multiway share, and its exact expectation
+ * is the hero's equity against one random hand (see ComputeHeadsUpEquity),
+ * so the adjusted estimate subtracts the part of the error that the control
+ * reveals. The coefficient is fitted by regression on the same units.
+ *
+ * The expectation is free preflop, where it comes from a table, but after
+ * the flop it takes an enumeration of every runout and opponent hand:
+ * about a million evaluations on the flop, which is several milliseconds,
+ * against a few thousand evaluations for a thousand deals. Since the
+ * control typically saves two or three times the deals, it is only applied
+ * when the enumeration costs no more evaluations than the deals themselves;
+ * otherwise has_control is false and the adjusted values equal the plain
+ * ones.
+ */
+struct EquityEstimate
+{
+    double equity;				/* estimated share of the pot */
+    double std_error;			/* standard error of the estimate */
+    double deal_variance;		/* variance of the share in a single deal */
+    double variance_reduction;	/* efficiency relative to plain sampling */
+    int64_t num_deals;			/* number of deals simulated */
+    bool has_control;			/* true if the control variate was applied */
+    double control_mean;		/* exact expectation of the control */
+    double adjusted_equity;		/* estimate adjusted by the control */
+    double adjusted_std_error;	/* standard error of the adjusted estimate */
+};
+
+/**
+ * Computes the exact equity of a hand against one random hand, on a board
+ * of zero or three to five known cards, excluding the dead cards. Preflop
+ * without dead cards the equity comes from a precomputed table; after the
+ * flop every runout and opponent hand is enumerated, which takes about a 
+ * million evaluations on the flop and a few thousand on the turn. Returns
+ * false for other inputs.
+ */
+bool ComputeHeadsUpEquity(const Hand &hero, const Hand &board, CardSet dead,
+                          double &equity);
+
+/**
+ * Estimates the equity of a hero hand against num_opponents random hands
+ * on a board with zero to five known cards, from about num_trials deals
+ * in the given sampling mode.
+ *
+ * The standard error is measured from independent units: single deals in
+ * plain mode, mirrored pairs in antithetic mode, and 16 replicates of the
+ * Sobol sequence, each with its own scramble, in Sobol mode. If use_control
+ * is true, the estimate is also adjusted by the heads-up control variate
+ * where it pays off (see EquityEstimate). Returns false if the input is
+ * invalid.
+ */
+bool EstimateEquity(const Hand &hero, const Hand &board, CardSet dead,
+                    int num_opponents, int num_trials, SamplingMode mode,
+                    unsigned int seed, EquityEstimate &result,
+                    bool use_control = false);
+
+/// Represents the equity of known hands computed within a time budget.
+struct TimedEquity
+{
+    double equity[MAX_EQUITY_PLAYERS];		/* share of the pot of each player */
+    double std_error[MAX_EQUITY_PLAYERS];	/* zero if exact */
+    int64_t num_deals;						/* number of runouts settled */
+    int64_t num_runouts;					/* number of distinct runouts */
+    bool exact;								/* true if every runout was settled */
+};
+
+/**
+ * Computes the equity of known hole cards on a board of zero to five known
+ * cards, using whatever time is left until the deadline.
+ *
+ * A short Monte Carlo warm-up measures the cost of a showdown. If every 
+ * runout can be settled in the remaining time, the runouts are listed and
+ * enumerated in parallel, which gives the exact equity. They are visited 
+ * in random order, so if the deadline passes before the enumeration is 
+ * done, the runouts settled so far are a sample without replacement and
+ * still give an unbiased estimate. Otherwise the threads deal random 
+ * runouts until the deadline.
+ *
+ * At least one batch of runouts is settled, even if the deadline has 
+ * already passed. Returns false if the hand is invalid.
+ */
+bool ComputeEquityByDeadline(const Hand *holes, int num_players,
+                             const Hand &board, CardSet dead,
+                             std::chrono::steady_clock::time_point deadline,
+                             unsigned int seed, TimedEquity &result);
+
+/**
+ * Computes the exact share of each player in several pots that are settled
+ * on the same runouts, such as a main pot and its side pots. The board has
+ * zero to five known cards. pot_players[k] is the bit-mask of the players 
+ * contesting pot k, and shares[k * num_players + i] receives the expected 
+ * share of pot k won by player i.
+ *
+ * Each runout evaluates every player once, and the pots only compare the
+ * strengths. The enumeration runs in the calling thread, so that callers 
+ * can run many of them in parallel. Returns false if the input is invalid.
+ */
+bool EnumeratePotShares(const Hand *holes, int num_players, const Hand &board,
+                        CardSet dead, const uint32_t *pot_players, int num_pots,
+                        double *shares);
+
+#endif /* HOLDEM_EQUITY_H */
@@ -3,6 +3,8 @@
 #include "hand.h"
 #include <cassert>
 #include <cctype>
+#include <unordered_map>
+#include <vector>
 #include "intrinsic.hpp"
 
 static const char rank_s[13] = { '2','3','4','5','6','7','8','9','T','J','Q','K','A' };
@@ -64,71 +66,14 @@ static RankMask KeepHighestBitSet(RankMask x)
 }
 
 /**
- * Evaluates a hand of five or seven cards and returns the strength of the
- * strongest five-card combination.
+ * Evaluates the ranks of a hand of five to seven cards that does not hold a
+ * flush. ranks_present is the mask of ranks present in the hand, and 
+ * ranks_N_times is the mask of ranks that appear at least N times.
  */
-HandStrength EvaluateHand(const Hand &hand)
+static HandStrength EvaluateRankMasks(
+    RankMask ranks_present, RankMask ranks_2_times, RankMask ranks_3_times,
+    RankMask ranks_4_times, int num_cards)
 {
-    // Let v be the rank masks excluding the counter bits.
-    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;  // rank mask
-    uint64_t sc = hand.value & 0xE000E000E000E000ULL; // suit counter
-
-    // Get the total number of cards in the hand.
-    int num_cards = ((sc >> 13) + (sc >> 29) + (sc >> 45) + (sc >> 61)) & 7;
-    assert(num_cards == 5 || num_cards == 7);
-
-    // Compute masks of the ranks present in the hand, ranks that appear at
-    // least twice, ranks that appear at least 3 times, etc.
-    RankMask ranks_present, ranks_2_times, ranks_3_times, ranks_4_times;
-    
-    RankMask m = (uint16_t)v;
-    ranks_present = m;
-    
-    m = (uint16_t)(v >> 16);
-    ranks_2_times = ranks_present & m;
-    ranks_present |= m;
-
-    m = (uint16_t)(v >> 32);
-    ranks_3_times = ranks_2_times & m;
-    ranks_2_times |= ranks_present & m;
-    ranks_present |= m;
-    
-    m = (uint16_t)(v >> 48);
-    ranks_4_times = ranks_3_times & m;
-    ranks_3_times |= ranks_2_times & m;
-    ranks_2_times |= ranks_present & m;
-    ranks_present |= m;
-
-    // Compute a mask of the flushed suit. (For seven or fewer cards, there
-    // can be at most one flushed suit.) To have five to seven cards of the
-    // same suit, the suit counter, x, must take one of the following values:
-    // 5 (101), 6 (110), 7(111). Any non-flush values (x <= 4) have either
-    // the 0x4 bit unset, or the 0x4 bit set but the lower 2 bits unset. Thus
-    // we can check for flushed suit by testing the following condition:
-    // bit 0x4 and (bit 0x2 or bit 0x1) != 0.
-    uint64_t test = sc & ((sc << 1) | (sc << 2)) & 0x8000800080008000ULL;
-    RankMask ranks_flushed = 0;
-    if (test)
-    {
-        Suit suit_flushed = (Suit)(intrinsic::bit_scan_reverse(sc) / 16);
-        ranks_flushed = (uint16_t)(v >> (16 * suit_flushed));
-    }
-
-    // Check for straight flush.
-    if (ranks_flushed)
-    {
-        // Check for straight within the flushed suit. This is automatic when
-        // there are exactly 5 cards; but when there are more than 5 cards, 
-        // straight and flush may not imply straight-flush. The algorithm to 
-        // check for straights is detailed later with "Check for straights".
-        RankMask m = (ranks_flushed << 1) | (ranks_flushed >> 12);
-        RankMask ranks_straight = (m & (m<<1) & (m<<2) & (m<<3) & (m<<4)) >> 1;
-        if (ranks_straight)
-        {
-            return HandStrength(StraightFlush, KeepHighestBitSet(ranks_straight));
-        }
-    }
-
     // Check for four-of-a-kind. For seven or fewer cards, there can be 
     // at most one four-of-a-kind combination.
     if (ranks_4_times)
@@ -151,18 +96,12 @@ HandStrength EvaluateHand(const Hand &hand)
         }
     }
 
-    // Check for flush.
-    if (ranks_flushed)
-    {
-        return HandStrength(Flush, KeepHighestBitsSet<5>(ranks_flushed));
-    }
-
     // Check for straights. We first copy the Ace-bit to the lowest bit so 
     // that we can easily test for 5-4-3-2-1 straight. Then a straight is 
     // such that there are five consecutive bits set in the mask. This can 
     // be tested by shift-and the mask five times. The highest bit left set
     // is the best straight. If no bit is left set, there are no straights.
-    m = (ranks_present << 1) | (ranks_present >> 12);
+    RankMask m = (ranks_present << 1) | (ranks_present >> 12);
     RankMask mask_straight = (m & (m << 1) & (m << 2) & (m << 3) & (m << 4)) >> 1;
     if (mask_straight)
     {
@@ -197,10 +136,9 @@ HandStrength EvaluateHand(const Hand &hand)
 #if 0
             KeepHighestBitsSet<3>(ranks_present & ~master);
 #else
-            if (num_cards == 7) // one pair + 5 high cards
+            for (int i = 5; i < num_cards; i++) // one pair + 4 or 5 high cards
             {
                 kicker &= (kicker - 1);
-                kicker &= (kicker - 1);
             }
 #endif
             return HandStrength(OnePair, master, kicker);
@@ -212,15 +150,410 @@ HandStrength EvaluateHand(const Hand &hand)
 #if 0
     kicker = KeepHighestBitsSet<5>(ranks_present);
 #else
-    if (num_cards == 7) // 7 high cards
+    for (int i = 5; i < num_cards; i++) // 6 or 7 high cards
     {
         kicker &= (kicker - 1);
-        kicker &= (kicker - 1);
     }
 #endif
     return HandStrength(HighCard, kicker);
 }
 
+/**
+ * Evaluates a hand of five to seven cards given the masks of the ranks that
+ * appear at least once, twice, three and four times in it.
+ */
+static inline HandStrength EvaluateMasks(
+    const Hand &hand, RankMask ranks_present, RankMask ranks_2_times,
+    RankMask ranks_3_times, RankMask ranks_4_times)
+{
+    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;  // rank mask
+    uint64_t sc = hand.value & 0xE000E000E000E000ULL; // suit counter
+    int num_cards = ((sc >> 13) + (sc >> 29) + (sc >> 45) + (sc >> 61)) & 7;
+    assert(num_cards >= 5 && num_cards <= 7);
+
+    // Compute a mask of the flushed suit. (For seven or fewer cards, there
+    // can be at most one flushed suit.) To have five to seven cards of the
+    // same suit, the suit counter, x, must take one of the following values:
+    // 5 (101), 6 (110), 7(111). Any non-flush values (x <= 4) have either
+    // the 0x4 bit unset, or the 0x4 bit set but the lower 2 bits unset. Thus
+    // we can check for flushed suit by testing the following condition:
+    // bit 0x4 and (bit 0x2 or bit 0x1) != 0. Only the flushed suit passes
+    // the test, so we locate it from the test bits rather than from the 
+    // counters, which may have a higher suit with fewer cards.
+    uint64_t test = sc & ((sc << 1) | (sc << 2)) & 0x8000800080008000ULL;
+
+    // Check for straight flush and flush. With at most seven cards, five of
+    // which are of the flushed suit, no rank can appear three times with 
+    // another rank appearing twice; so a flush beats anything but a 
+    // straight flush, and the remaining checks only need the ranks.
+    if (test)
+    {
+        Suit suit_flushed = (Suit)(intrinsic::bit_scan_reverse(test) / 16);
+        RankMask ranks_flushed = (uint16_t)(v >> (16 * suit_flushed));
+
+        // Check for straight within the flushed suit. This is automatic when
+        // there are exactly 5 cards; but when there are more than 5 cards, 
+        // straight and flush may not imply straight-flush. The algorithm to 
+        // check for straights is detailed in EvaluateRankMasks.
+        RankMask m = (ranks_flushed << 1) | (ranks_flushed >> 12);
+        RankMask ranks_straight = (m & (m<<1) & (m<<2) & (m<<3) & (m<<4)) >> 1;
+        if (ranks_straight)
+        {
+            return HandStrength(StraightFlush, KeepHighestBitSet(ranks_straight));
+        }
+        return HandStrength(Flush, KeepHighestBitsSet<5>(ranks_flushed));
+    }
+
+    return EvaluateRankMasks(ranks_present, ranks_2_times, ranks_3_times,
+                             ranks_4_times, num_cards);
+}
+
+/**
+ * Evaluates a hand of five to seven cards and returns the strength of the
+ * strongest five-card combination.
+ */
+HandStrength EvaluateHand(const Hand &hand)
+{
+    // Let v be the rank masks excluding the counter bits.
+    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;
+
+    // Compute masks of the ranks present in the hand, ranks that appear at
+    // least twice, ranks that appear at least 3 times, etc.
+    RankMask ranks_present, ranks_2_times, ranks_3_times, ranks_4_times;
+    
+    RankMask m = (uint16_t)v;
+    ranks_present = m;
+    
+    m = (uint16_t)(v >> 16);
+    ranks_2_times = ranks_present & m;
+    ranks_present |= m;
+
+    m = (uint16_t)(v >> 32);
+    ranks_3_times = ranks_2_times & m;
+    ranks_2_times |= ranks_present & m;
+    ranks_present |= m;
+    
+    m = (uint16_t)(v >> 48);
+    ranks_4_times = ranks_3_times & m;
+    ranks_3_times |= ranks_2_times & m;
+    ranks_2_times |= ranks_present & m;
+    ranks_present |= m;
+
+    return EvaluateMasks(hand, ranks_present, ranks_2_times, ranks_3_times,
+                         ranks_4_times);
+}
+
+IncrementalHand::IncrementalHand(const Hand &hand)
+    : rank_counts_(0)
+{
+    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;
+    while (v)
+    {
+        Add(Hand((v & (0 - v)) | (0x2000ULL << (intrinsic::bit_scan_forward(v) & ~15))));
+        v &= v - 1;
+    }
+}
+
+HandStrength IncrementalHand::Evaluate() const
+{
+    return EvaluateMasks(hand_, GetRanks(1), GetRanks(2), GetRanks(3), GetRanks(4));
+}
+
+HandStrength IncrementalHand::Evaluate(const Hand &card) const
+{
+    uint64_t ranks = GetRankLanes(card);
+    uint64_t counts = rank_counts_ | ((rank_counts_ & ranks) << 16) | (ranks & 0x1FFF);
+    return EvaluateMasks(hand_ + card, (RankMask)(counts & 0x1FFF),
+                         (RankMask)((counts >> 16) & 0x1FFF),
+                         (RankMask)((counts >> 32) & 0x1FFF),
+                         (RankMask)((counts >> 48) & 0x1FFF));
+}
+
+/**
+ * Selects the five cards of a hand that make up the given strength, which 
+ * must be the strength of the hand. Only the master and kicker masks and 
+ * the flushed suit are needed, so this costs a fraction of an evaluation.
+ */
+static Hand SelectBestFive(const Hand &hand, HandStrength strength)
+{
+    // For each category, the masks below select which of the master and 
+    // kicker ranks need two, three and four cards. They replace branches
+    // on the category, which are hard to predict.
+    static const RankMask master_2[9] = { 0, 0x1FFF, 0x1FFF, 0x1FFF, 0, 0, 0x1FFF, 0x1FFF, 0 };
+    static const RankMask kicker_2[9] = { 0, 0, 0, 0, 0, 0, 0x1FFF, 0, 0 };
+    static const RankMask master_3[9] = { 0, 0, 0, 0x1FFF, 0, 0, 0x1FFF, 0x1FFF, 0 };
+    static const RankMask master_4[9] = { 0, 0, 0, 0, 0, 0, 0, 0x1FFF, 0 };
+
+    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;
+    uint64_t sc = hand.value & 0xE000E000E000E000ULL;
+    HandCategory category = strength.GetCategory();
+    RankMask master = (RankMask)((strength.value >> 13) & 0x1FFF);
+    RankMask kicker = (RankMask)(strength.value & 0x1FFF);
+
+    // The master of a straight is its top rank; expand it to the five 
+    // ranks, with the ace playing low in A2345.
+    if (category == Straight || category == StraightFlush)
+    {
+        int top = intrinsic::bit_scan_forward(master);
+        master = (RankMask)(((0x1F << top) >> 4) | ((top == Rank_5) << Rank_Ace));
+    }
+
+    // All five cards of a flush are of the flushed suit (see EvaluateHand).
+    if (category == Flush || category == StraightFlush)
+    {
+        uint64_t test = sc & ((sc << 1) | (sc << 2)) & 0x8000800080008000ULL;
+        int suit_flushed = intrinsic::bit_scan_reverse(test) / 16;
+        v &= 0x1FFFULL << (16 * suit_flushed);
+    }
+
+    // Let need_N be the mask of ranks of which N or more cards are still 
+    // to be taken. Going through the suits, take every card whose rank is
+    // still needed, and move that rank down by one.
+    RankMask need_1 = master | kicker;
+    RankMask need_2 = (master & master_2[category]) | (kicker & kicker_2[category]);
+    RankMask need_3 = master & master_3[category];
+    RankMask need_4 = master & master_4[category];
+    uint64_t selected = 0;
+    for (int suit = 0; suit < 4; suit++)
+    {
+        RankMask take = (RankMask)(v >> (16 * suit)) & need_1;
+        selected |= (uint64_t)take << (16 * suit);
+        need_1 = (need_1 & ~take) | (need_2 & take);
+        need_2 = (need_2 & ~take) | (need_3 & take);
+        need_3 = (need_3 & ~take) | (need_4 & take);
+        need_4 &= ~take;
+    }
+
+    // Count the cards of each suit in parallel to fill in the counters.
+    uint64_t n = selected - ((selected >> 1) & 0x5555555555555555ULL);
+    n = (n & 0x3333333333333333ULL) + ((n >> 2) & 0x3333333333333333ULL);
+    n = (n + (n >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    n = (n + (n >> 8)) & 0x001F001F001F001FULL;
+    return Hand(selected | (n << 13));
+}
+
+HandStrength EvaluateHand(const Hand &hand, Hand &best_five)
+{
+    HandStrength strength = EvaluateHand(hand);
+    best_five = SelectBestFive(hand, strength);
+    return strength;
+}
+
+/**
+ * Evaluates a hand of exactly five cards. Since every card plays, the master
+ * and kicker masks are read off the rank masks directly without trimming,
+ * and a hand with five distinct ranks cannot hold any pair.
+ */
+HandStrength EvaluateFiveCards(const Hand &hand)
+{
+    uint64_t v = hand.value & 0x1FFF1FFF1FFF1FFFULL;  // rank mask
+    uint64_t sc = hand.value & 0xE000E000E000E000ULL; // suit counter
+    assert(hand.GetCardCount() == 5);
+
+    RankMask m0 = (uint16_t)v;
+    RankMask m1 = (uint16_t)(v >> 16);
+    RankMask m2 = (uint16_t)(v >> 32);
+    RankMask m3 = (uint16_t)(v >> 48);
+    RankMask ranks_present = m0 | m1 | m2 | m3;
+
+    RankMask ranks_2_times = (m0 & m1) | (m0 & m2) | (m0 & m3) | 
+                             (m1 & m2) | (m1 & m3) | (m2 & m3);
+
+    // Five distinct ranks make a straight flush, flush, straight, or high
+    // card. Among the suit counter values, only 5 (101) has both bit 0x4
+    // and bit 0x1 set, so a flush is found by a single test.
+    if (ranks_2_times == 0)
+    {
+        bool is_flush = (sc & (sc << 2) & 0x8000800080008000ULL) != 0;
+        RankMask m = (ranks_present << 1) | (ranks_present >> 12);
+        RankMask ranks_straight = (m & (m<<1) & (m<<2) & (m<<3) & (m<<4)) >> 1;
+        if (ranks_straight)
+            return HandStrength(is_flush? StraightFlush : Straight, ranks_straight);
+        return HandStrength(is_flush? Flush : HighCard, ranks_present);
+    }
+
+    RankMask ranks_3_times = (m0 & m1 & m2) | (m0 & m1 & m3) | 
+                             (m0 & m2 & m3) | (m1 & m2 & m3);
+    RankMask ranks_4_times = m0 & m1 & m2 & m3;
+
+    if (ranks_4_times)
+    {
+        return HandStrength(FourOfAKind, ranks_4_times, 
+                            ranks_present & ~ranks_4_times);
+    }
+    if (ranks_3_times)
+    {
+        RankMask pair = ranks_2_times & ~ranks_3_times;
+        if (pair)
+            return HandStrength(FullHouse, ranks_3_times, pair);
+        return HandStrength(ThreeOfAKind, ranks_3_times, 
+                            ranks_present & ~ranks_3_times);
+    }
+    return HandStrength((ranks_2_times & (ranks_2_times - 1))? TwoPair : OnePair,
+                        ranks_2_times, ranks_present & ~ranks_2_times);
+}
+
+const uint32_t RankKeys[13] = 
+{
+    0, 1, 5, 22, 98, 453, 2031, 8698, 22854, 83661, 262349, 636345, 1479181
+};
+
+/// The largest rank key sum of seven cards, attained by AAAAKKK.
+#define MAX_RANK_SUM (4 * 1479181 + 3 * 636345)
+
+/**
+ * Fills the rank sum table by enumerating every multiset of seven ranks in
+ * which no rank appears more than four times (49,205 in total). The rank
+ * masks are built up rank by rank so each multiset costs one evaluation.
+ */
+static void FillRankSumTable(uint16_t *index, std::vector<HandStrength> &strengths,
+                             std::unordered_map<uint32_t, uint16_t> &numbers,
+                             int rank, int num_left, uint32_t sum, 
+                             const RankMask ranks[4])
+{
+    if (num_left == 0)
+    {
+        HandStrength strength = EvaluateRankMasks(ranks[0], ranks[1], ranks[2],
+                                                  ranks[3], 7);
+        auto it = numbers.find(strength.value);
+        if (it == numbers.end())
+        {
+            it = numbers.insert(std::make_pair(strength.value, 
+                (uint16_t)strengths.size())).first;
+            strengths.push_back(strength);
+        }
+        index[sum] = it->second;
+        return;
+    }
+    if (rank == 13)
+        return;
+
+    RankMask next[4] = { ranks[0], ranks[1], ranks[2], ranks[3] };
+    for (int count = 0; count <= 4 && count <= num_left; count++)
+    {
+        FillRankSumTable(index, strengths, numbers, rank + 1, num_left - count,
+                         sum + count * RankKeys[rank], next);
+        if (count < 4)
+            next[count] |= (RankMask)(1 << rank);
+    }
+}
+
+const RankSumTable& GetRankSumTable()
+{
+    static const RankSumTable table = []()
+    {
+        static std::vector<uint16_t> index(MAX_RANK_SUM + 1);
+        static std::vector<HandStrength> strengths;
+        std::unordered_map<uint32_t, uint16_t> numbers;
+        RankMask ranks[4] = { 0, 0, 0, 0 };
+        FillRankSumTable(&index[0], strengths, numbers, 0, 7, 0, ranks);
+
+        RankSumTable t;
+        t.index = &index[0];
+        t.strengths = &strengths[0];
+        return t;
+    }();
+    return table;
+}
+
+const uint32_t* GetLaneKeyTable()
+{
+    static const std::vector<uint32_t> table = []()
+    {
+        std::vector<uint32_t> t(1 << 13);
+        for (uint32_t m = 1; m < (1 << 13); m++)
+        {
+            int r = intrinsic::bit_scan_forward(m);
+            t[m] = t[m & (m - 1)] + RankKeys[r];
+        }
+        return t;
+    }();
+    return &table[0];
+}
+
+/// Marks a hand that is not looked up in the rank sum table.
+#define NOT_A_RANK_SUM 0xFFFFFFFFU
+
+void EvaluateHands(const Hand *hands, HandStrength *strengths, size_t count,
+                   int prefetch_distance)
+{
+    const RankSumTable &table = GetRankSumTable();
+    const uint32_t *lane_keys = GetLaneKeyTable();
+    size_t distance = (size_t)std::max(0, std::min(prefetch_distance, 
+                                                   MAX_PREFETCH_DISTANCE));
+
+    // Each hand passes through two stages: its key sum is computed and its
+    // table entry prefetched, then, distance hands later, it is looked up.
+    // A ring buffer holds the sums in between; its size is a power of two
+    // larger than any distance.
+    const size_t ring_mask = 2 * MAX_PREFETCH_DISTANCE - 1;
+    uint32_t sums[2 * MAX_PREFETCH_DISTANCE];
+    for (size_t i = 0; i < count + distance; i++)
+    {
+        if (i < count)
+        {
+            // Seven cards with no suit counter above four.
+            uint64_t v = hands[i].value;
+            uint64_t sc = (v >> 13) & 0x0007000700070007ULL;
+            uint32_t sum = NOT_A_RANK_SUM;
+            if (((sc + (sc >> 16) + (sc >> 32) + (sc >> 48)) & 7) == 7 &&
+                ((sc + 0x0003000300030003ULL) & 0x0008000800080008ULL) == 0)
+            {
+                sum = lane_keys[v & 0x1FFF] + lane_keys[(v >> 16) & 0x1FFF] +
+                      lane_keys[(v >> 32) & 0x1FFF] + lane_keys[(v >> 48) & 0x1FFF];
+                if (distance > 0)
+                    intrinsic::prefetch(&table.index[sum]);
+            }
+            sums[i & ring_mask] = sum;
+        }
+        if (i >= distance)
+        {
+            size_t j = i - distance;
+            uint32_t sum = sums[j & ring_mask];
+            strengths[j] = (sum != NOT_A_RANK_SUM)? table.Lookup(sum) : 
+                                                    EvaluateHand(hands[j]);
+        }
+    }
+}
+
+void EvaluateHands(const Hand *hands, HandStrength *strengths, Hand *best_fives,
+                   size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        strengths[i] = EvaluateHand(hands[i], best_fives[i]);
+    }
+}
+
+void EvaluateFiveCardHands(const Hand *hands, HandStrength *strengths, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        strengths[i] = EvaluateFiveCards(hands[i]);
+    }
+}
+
+LowStrength EvaluateLow(const Hand &hand)
+{
+    // Collect the ranks present in any suit, then rotate the mask so that
+    // the ace takes bit 0 and the eight takes bit 7. Ranks above eight are
+    // discarded since they never play in an eight-or-better low.
+    uint64_t v = hand.value;
+    RankMask ranks_present = (RankMask)((v | (v >> 16) | (v >> 32) | (v >> 48)) & 0x1FFF);
+    RankMask m = ((ranks_present << 1) | (ranks_present >> 12)) & 0xFF;
+    if (intrinsic::pop_count(m) < 5)
+        return LowStrength();
+
+    // Keep the five lowest ranks; these make the best low.
+    RankMask low = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        low |= m & (RankMask)(-m);
+        m &= (m - 1);
+    }
+    return LowStrength(0x100 - low);
+}
+
 #if 0
 void write_hand(char s[19], const hand_t &h)
 {
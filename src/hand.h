@@ -1,6 +1,7 @@
 #ifndef HOLDEM_HAND_H
 #define HOLDEM_HAND_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* Represents the rank of a card. */
@@ -114,6 +115,19 @@ struct Hand
 
     int GetCards(Card *cards) const;
 
+    /// Returns the number of cards in the hand.
+    int GetCardCount() const
+    {
+        uint64_t sc = value & 0xE000E000E000E000ULL;
+        return (int)(((sc >> 13) + (sc >> 29) + (sc >> 45) + (sc >> 61)) & 7);
+    }
+
+    /// Returns the cards in the hand as a card set.
+    uint64_t GetCardSet() const
+    {
+        return value & 0x1FFF1FFF1FFF1FFFULL;
+    }
+
     Hand& operator += (const Hand &a)
     {
         this->value += a.value;
@@ -133,6 +147,14 @@ inline Hand operator + (const Hand &a, const Hand &b)
     return Hand(a.value + b.value);
 }
 
+/**
+ * Represents an arbitrary set of cards, such as the dead cards or the cards
+ * remaining in the deck. The layout is the same as Hand::value except that
+ * the suit counters are always zero; this allows a card set to hold any 
+ * number of cards, while a Hand is limited to seven.
+ */
+typedef uint64_t CardSet;
+
 /**
  * Represents a bit-mask of ranks, where a bit is set if and only if the
  * corresponding rank is present. Only the lower 13 bits are used, and the
@@ -192,6 +214,8 @@ struct HandStrength
         : value((category << 26) | (master << 13) | kicker) { }
     HandStrength(HandCategory category, RankMask master)
         : value((category << 26) | (master << 13)) { }
+
+    HandCategory GetCategory() const { return (HandCategory)(value >> 26); }
 };
 
 inline bool operator > (const HandStrength &a, const HandStrength &b)
@@ -220,6 +244,192 @@ inline bool operator != (const HandStrength &a, const HandStrength &b)
  */
 HandStrength EvaluateHand(const Hand &hand);
 
+/// Default number of hands that batch lookups prefetch ahead.
+#define DEFAULT_PREFETCH_DISTANCE 16
+
+/// Largest supported prefetch distance.
+#define MAX_PREFETCH_DISTANCE 64
+
+/**
+ * Evaluates a batch of hands. This is equivalent to calling EvaluateHand on
+ * each hand, but lets enumeration loops collect a whole deal (or a chunk of 
+ * deals) before evaluating them in one tight loop.
+ *
+ * Hands of seven cards without a flush are looked up in the rank sum table
+ * (see RankSumTable), which is larger than the L2 cache. The key sum of
+ * each hand is computed prefetch_distance hands ahead of its lookup, and
+ * the table entry prefetched then, so that the cache misses of many hands
+ * overlap instead of being waited for one at a time. A distance of zero
+ * turns the prefetches off.
+ */
+void EvaluateHands(const Hand *hands, HandStrength *strengths, size_t count,
+                   int prefetch_distance = DEFAULT_PREFETCH_DISTANCE);
+
+/**
+ * Evaluates a hand of five to seven cards like EvaluateHand, and also stores
+ * the five cards that make up the strongest combination in best_five. If 
+ * several combinations have the same strength, one of them is chosen.
+ */
+HandStrength EvaluateHand(const Hand &hand, Hand &best_five);
+
+/// Evaluates a batch of hands with EvaluateHand, storing the best five cards
+/// of each hand.
+void EvaluateHands(const Hand *hands, HandStrength *strengths, Hand *best_fives,
+                   size_t count);
+
+/**
+ * Keys for the thirteen ranks, chosen such that the sum of the keys of the
+ * seven ranks of a seven-card hand is different for every multiset of 
+ * ranks. Since the strength of a hand without a flush depends only on the
+ * multiset of its ranks, the key sum can index a table of strengths.
+ */
+extern const uint32_t RankKeys[13];
+
+/**
+ * Represents a lookup table from the rank key sum of a seven-card hand 
+ * without a flush to its strength.
+ *
+ * The table is indexed by key sums up to 7.8 million, but there are only a
+ * few thousand distinct strengths, so the table stores a 16-bit strength 
+ * number for each key sum, which is then looked up in a small array of 
+ * strengths.
+ */
+struct RankSumTable
+{
+    const uint16_t *index;
+    const HandStrength *strengths;
+
+    HandStrength Lookup(uint32_t rank_sum) const
+    {
+        return strengths[index[rank_sum]];
+    }
+};
+
+/// Returns the rank sum table, building it on first use.
+const RankSumTable& GetRankSumTable();
+
+/**
+ * Returns the sum of the rank keys of each 13-bit rank mask, so that the
+ * key sum of a hand takes one lookup per suit. The table takes 32 KB.
+ */
+const uint32_t* GetLaneKeyTable();
+
+/**
+ * Holds a hand together with the masks of the ranks that appear at least
+ * once, twice, three and four times, so that adding or removing a card
+ * takes a few bit operations instead of a recount of all the suit lanes.
+ * Evaluate gives the same result as EvaluateHand on the hand, whose suit
+ * counters still detect flushes.
+ *
+ * The four masks are packed in one integer, 16 bits each, in the layout
+ * of Hand::value: the mask of the ranks that appear at least n times is
+ * bits 16(n-1) to 16(n-1)+12. Since each mask holds the next, a card of
+ * a rank that appears c times joins mask c+1 when the ranks are shifted
+ * up by one mask, and leaves mask c when they are shifted down.
+ *
+ * The cards are passed as Hands of exactly one card, such as Deck::cards.
+ */
+class IncrementalHand
+{
+public:
+    IncrementalHand() : rank_counts_(0) { }
+    explicit IncrementalHand(const Hand &hand);
+
+    /// Adds a card, which must not be in the hand.
+    void Add(const Hand &card)
+    {
+        uint64_t ranks = GetRankLanes(card);
+        rank_counts_ |= ((rank_counts_ & ranks) << 16) | (ranks & 0x1FFF);
+        hand_.value += card.value;
+    }
+
+    /// Removes a card, which must be in the hand.
+    void Remove(const Hand &card)
+    {
+        uint64_t ranks = GetRankLanes(card);
+        rank_counts_ = (rank_counts_ & ~ranks) | ((rank_counts_ & ranks) >> 16);
+        hand_.value -= card.value;
+    }
+
+    /// Returns the cards in the hand.
+    const Hand& GetHand() const { return hand_; }
+
+    /// Returns the mask of the ranks that appear at least n times, for n
+    /// from 1 to 4.
+    RankMask GetRanks(int n) const
+    {
+        return (RankMask)((rank_counts_ >> (16 * (n - 1))) & 0x1FFF);
+    }
+
+    /// Evaluates the hand, which must hold five to seven cards.
+    HandStrength Evaluate() const;
+
+    /// Evaluates the hand with one more card, without changing it, which
+    /// saves the Add and Remove around the innermost loop of enumerations.
+    HandStrength Evaluate(const Hand &card) const;
+
+private:
+    /// Returns the rank of a card as a bit repeated in every lane.
+    static uint64_t GetRankLanes(const Hand &card)
+    {
+        uint64_t v = card.value & 0x1FFF1FFF1FFF1FFFULL;
+        v |= (v >> 16) | (v >> 32) | (v >> 48);
+        return (v & 0x1FFF) * 0x0001000100010001ULL;
+    }
+
+    Hand hand_;
+    uint64_t rank_counts_;
+};
+
+/**
+ * Evaluates a hand of exactly five cards. This is a fast path for draw games,
+ * where every card plays and no best-five selection is needed; the result is
+ * identical to that of EvaluateHand.
+ */
+HandStrength EvaluateFiveCards(const Hand &hand);
+
+/// Evaluates a batch of five-card hands with EvaluateFiveCards.
+void EvaluateFiveCardHands(const Hand *hands, HandStrength *strengths, size_t count);
+
+/**
+ * Represents the strength of an ace-to-five low hand that qualifies under 
+ * the eight-or-better rule. 
+ *
+ * The five ranks of the low hand are stored as a bit-mask where the ace is
+ * bit 0, the duce is bit 1, ..., and the eight is bit 7. A lower mask is a 
+ * better low, so the mask is stored subtracted from 0x100; this keeps the 
+ * convention that a greater value is a stronger hand. A value of zero means
+ * the hand does not have a qualifying low.
+ *
+ *   Example  Mask        Value
+ *   --------------------------
+ *   5432A    00011111    0xE1
+ *   8765A    11110001    0x0F
+ *   (none)   -           0x00
+ */
+struct LowStrength
+{
+    uint32_t value;
+    LowStrength() : value(0) { }
+    explicit LowStrength(uint32_t _value) : value(_value) { }
+};
+
+inline bool operator > (const LowStrength &a, const LowStrength &b)
+{
+    return a.value > b.value;
+}
+
+inline bool operator == (const LowStrength &a, const LowStrength &b)
+{
+    return a.value == b.value;
+}
+
+/**
+ * Evaluates a hand of five to seven cards for ace-to-five low, eight or
+ * better. Straights and flushes do not count against a low hand.
+ */
+LowStrength EvaluateLow(const Hand &hand);
+
 /// Gets the character that represents a given rank.
 char format_rank(Rank rank);
 
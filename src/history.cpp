@@ -0,0 +1,540 @@
+#include "history.h"
+#include "equity.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+/// Returns the Hand with its four suit lanes reordered so that the lane of
+/// suit s moves to suit perm[s].
+static uint64_t PermuteSuits(uint64_t value, const int perm[4])
+{
+    uint64_t result = 0;
+    for (int s = 0; s < 4; s++)
+        result |= ((value >> (16 * s)) & 0xFFFF) << (16 * perm[s]);
+    return result;
+}
+
+bool PotShareCache::GetPotShares(const Hand *holes, int num_players,
+                                 const Hand &board, CardSet dead,
+                                 const uint32_t *pot_players, int num_pots,
+                                 double *shares)
+{
+    if (num_players < 1 || num_players > MAX_HISTORY_SEATS ||
+        num_pots < 1 || num_pots > MAX_HISTORY_SEATS)
+        return false;
+
+    // Build the key under each suit permutation and keep the smallest. Only
+    // the cards depend on the permutation; the pots and the counts go last.
+    PotShareKey key, candidate;
+    candidate.fill(0);
+    for (int k = 0; k < num_pots; k++)
+    {
+        candidate[MAX_HISTORY_SEATS + 2 + k / 4] |=
+            (uint64_t)(pot_players[k] & 0xFFFF) << (16 * (k % 4));
+    }
+    candidate[POT_SHARE_KEY_WORDS - 1] = (uint64_t)num_players | ((uint64_t)num_pots << 8);
+    int perm[4] = { 0, 1, 2, 3 };
+    bool first = true;
+    do
+    {
+        for (int i = 0; i < num_players; i++)
+            candidate[i] = PermuteSuits(holes[i].value, perm);
+        candidate[MAX_HISTORY_SEATS] = PermuteSuits(board.value, perm);
+        candidate[MAX_HISTORY_SEATS + 1] = PermuteSuits(dead, perm);
+        if (first || candidate < key)
+            key = candidate;
+        first = false;
+    } while (std::next_permutation(perm, perm + 4));
+
+    size_t count = (size_t)(num_pots * num_players);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++num_lookups_;
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            ++num_hits_;
+            std::copy(it->second.begin(), it->second.end(), shares);
+            return true;
+        }
+    }
+
+    // Enumerate outside the lock. Two threads may occasionally compute the
+    // same entry, which is harmless.
+    if (!EnumeratePotShares(holes, num_players, board, dead, pot_players,
+                            num_pots, shares))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.size() >= max_entries_ && entries_.find(key) == entries_.end())
+        entries_.erase(entries_.begin());
+    entries_[key].assign(shares, shares + count);
+    return true;
+}
+
+/// Parses a card such as "Ah" or "Td". Returns false if it is not a card.
+static bool ParseCard(const char *s, Hand &card)
+{
+    static const char ranks[] = "23456789TJQKA";
+    static const char suits[] = "cdhs";
+    const char *r = (s[0] != 0)? strchr(ranks, s[0]) : NULL;
+    const char *u = (s[0] != 0 && s[1] != 0)? strchr(suits, s[1]) : NULL;
+    if (r == NULL || u == NULL)
+        return false;
+    card = Hand(Card((Rank)(r - ranks), (Suit)(u - suits)));
+    return true;
+}
+
+/// Parses the cards between the brackets at the start of s, e.g. "[Ah Kd]".
+/// Returns the number of cards parsed, or -1 if the text is malformed.
+static int ParseCardList(const char *s, Hand &cards)
+{
+    cards = Hand();
+    if (*s != '[')
+        return -1;
+    int n = 0;
+    for (++s; *s && *s != ']'; )
+    {
+        Hand card;
+        if (n >= 7 || !ParseCard(s, card) || (cards.value & card.GetCardSet()))
+            return -1;
+        cards += card;
+        ++n;
+        s += 2;
+        while (*s == ' ')
+            ++s;
+    }
+    return (*s == ']')? n : -1;
+}
+
+/// Parses an amount such as "$1,234.50" or "1500". Returns 0 if there is
+/// no number.
+static double ParseAmount(const char *s)
+{
+    char digits[32];
+    size_t n = 0;
+    while (*s == ' ' || *s == '(' || *s == '$' || (unsigned char)*s >= 0x80)
+        ++s;
+    for (; *s && n + 1 < sizeof(digits); s++)
+    {
+        if (*s == ',')
+            continue;
+        if ((*s < '0' || *s > '9') && *s != '.')
+            break;
+        digits[n++] = *s;
+    }
+    digits[n] = 0;
+    return atof(digits);
+}
+
+/// Returns true if s starts with prefix.
+static bool StartsWith(const std::string &s, const char *prefix)
+{
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+/// Represents what is known of one player during the parsing of a hand.
+struct SeatState
+{
+    std::string name;
+    double put_in;		/* total amount put in the pot */
+    double street_bet;	/* amount bet on the current street */
+    double collected;	/* amount collected from the pots */
+    bool folded;
+    Hand hole;			/* hole cards, if known */
+};
+
+/**
+ * Represents one hand being parsed. The lines of a hand are fed one by one,
+ * and the results are added once the hand is complete.
+ */
+class HandParser
+{
+public:
+    HandParser() { Reset(); }
+
+    /// Clears the state for a new hand.
+    void Reset()
+    {
+        num_seats_ = 0;
+        num_board_ = 0;
+        boards_[0] = Hand();
+        board_at_last_action_ = 0;
+        started_ = false;
+        dealt_ = false;
+        valid_ = true;
+    }
+
+    /// Returns true if some lines of a hand have been read.
+    bool IsStarted() const { return started_; }
+
+    void ParseLine(const std::string &line);
+
+    /// Adds the results of the hand to results. Returns false if the hand
+    /// was skipped.
+    bool Finish(PotShareCache &cache, PlayerResults &results);
+
+private:
+    /// Returns the seat whose name starts the line and is followed by
+    /// ": ", or -1. The text after the colon is stored in rest.
+    int FindActor(const std::string &line, const char *&rest) const;
+
+    SeatState seats_[MAX_HISTORY_SEATS];
+    int num_seats_;
+    Hand boards_[6];			/* the board after each number of cards */
+    int num_board_;
+    int board_at_last_action_;	/* board cards when the last bet was made */
+    bool started_;
+    bool dealt_;				/* true once the hole cards are dealt */
+    bool valid_;
+};
+
+int HandParser::FindActor(const std::string &line, const char *&rest) const
+{
+    // Names may contain spaces and colons, so prefer the longest match.
+    int best = -1;
+    size_t best_length = 0;
+    for (int i = 0; i < num_seats_; i++)
+    {
+        const std::string &name = seats_[i].name;
+        if (name.size() >= best_length && line.size() > name.size() + 1 &&
+            line.compare(0, name.size(), name) == 0 &&
+            line[name.size()] == ':' && line[name.size() + 1] == ' ')
+        {
+            best = i;
+            best_length = name.size();
+        }
+    }
+    if (best >= 0)
+        rest = line.c_str() + best_length + 2;
+    return best;
+}
+
+void HandParser::ParseLine(const std::string &line)
+{
+    if (!started_)
+    {
+        // Only hold'em hands are handled.
+        if (!StartsWith(line, "PokerStars "))
+            return;
+        started_ = true;
+        valid_ = (line.find("Hold'em") != std::string::npos);
+        return;
+    }
+    if (!valid_)
+        return;
+
+    if (!dealt_ && StartsWith(line, "Seat ") &&
+        line.find(" in chips") != std::string::npos)
+    {
+        // "Seat 3: name (1500 in chips)" before the cards are dealt.
+        size_t colon = line.find(": ");
+        size_t paren = line.rfind(" (");
+        if (colon == std::string::npos || paren == std::string::npos ||
+            paren <= colon || num_seats_ >= MAX_HISTORY_SEATS)
+            return;
+        SeatState &seat = seats_[num_seats_++];
+        seat.name = line.substr(colon + 2, paren - colon - 2);
+        seat.put_in = seat.street_bet = seat.collected = 0;
+        seat.folded = false;
+        seat.hole = Hand();
+        return;
+    }
+
+    if (StartsWith(line, "*** "))
+    {
+        dealt_ = true;
+        // A new street: "*** FLOP *** [Ah Kd 2c]", "*** TURN *** [...] [5s]".
+        bool flop = StartsWith(line, "*** FLOP ***");
+        if (flop || StartsWith(line, "*** TURN ***") ||
+            StartsWith(line, "*** RIVER ***"))
+        {
+            size_t open = line.rfind('[');
+            Hand cards;
+            int n = (open == std::string::npos)? -1 :
+                ParseCardList(line.c_str() + open, cards);
+            if (n < 0 || (flop && n != 3) || (!flop && n != 1))
+            {
+                valid_ = false;
+                return;
+            }
+            boards_[num_board_ + n] = boards_[num_board_] + cards;
+            num_board_ += n;
+            for (int i = 0; i < num_seats_; i++)
+                seats_[i].street_bet = 0;
+        }
+        return;
+    }
+
+    if (StartsWith(line, "Dealt to "))
+    {
+        // "Dealt to name [Ah Kd]"
+        size_t open = line.rfind(" [");
+        for (int i = 0; open != std::string::npos && i < num_seats_; i++)
+        {
+            if (line.compare(9, open - 9, seats_[i].name) == 0)
+                ParseCardList(line.c_str() + open + 1, seats_[i].hole);
+        }
+        return;
+    }
+
+    if (StartsWith(line, "Uncalled bet ("))
+    {
+        // "Uncalled bet (150) returned to name"
+        const char *to = strstr(line.c_str(), ") returned to ");
+        if (to == NULL)
+            return;
+        double amount = ParseAmount(line.c_str() + 13);
+        for (int i = 0; i < num_seats_; i++)
+        {
+            if (seats_[i].name == to + 14)
+            {
+                seats_[i].put_in -= amount;
+                seats_[i].street_bet -= amount;
+            }
+        }
+        return;
+    }
+
+    const char *rest = NULL;
+    int actor = FindActor(line, rest);
+    if (actor >= 0)
+    {
+        SeatState &seat = seats_[actor];
+        if (strncmp(rest, "posts the ante ", 15) == 0)
+        {
+            seat.put_in += ParseAmount(rest + 15);
+        }
+        else if (strncmp(rest, "posts ", 6) == 0)
+        {
+            // Blinds count towards the bet of the first street. The amount
+            // is the last number on the line.
+            const char *p = strrchr(rest, ' ');
+            double amount = ParseAmount(p + 1);
+            seat.put_in += amount;
+            seat.street_bet += amount;
+        }
+        else if (strncmp(rest, "bets ", 5) == 0 || strncmp(rest, "calls ", 6) == 0)
+        {
+            double amount = ParseAmount(strchr(rest, ' ') + 1);
+            seat.put_in += amount;
+            seat.street_bet += amount;
+            board_at_last_action_ = num_board_;
+        }
+        else if (strncmp(rest, "raises ", 7) == 0)
+        {
+            // "raises 100 to 300": the bet on this street becomes 300.
+            const char *to = strstr(rest, " to ");
+            if (to == NULL)
+            {
+                valid_ = false;
+                return;
+            }
+            double amount = ParseAmount(to + 4);
+            seat.put_in += amount - seat.street_bet;
+            seat.street_bet = amount;
+            board_at_last_action_ = num_board_;
+        }
+        else if (strncmp(rest, "checks", 6) == 0)
+        {
+            board_at_last_action_ = num_board_;
+        }
+        else if (strncmp(rest, "folds", 5) == 0)
+        {
+            seat.folded = true;
+            board_at_last_action_ = num_board_;
+            if (rest[5] == ' ')
+                ParseCardList(rest + 6, seat.hole);
+        }
+        else if (strncmp(rest, "shows ", 6) == 0)
+        {
+            ParseCardList(rest + 6, seat.hole);
+        }
+        return;
+    }
+
+    // "name collected 300 from pot", "... from side pot-1", etc.
+    size_t collected = line.find(" collected ");
+    if (collected != std::string::npos && line.find(" from ", collected) != std::string::npos)
+    {
+        for (int i = 0; i < num_seats_; i++)
+        {
+            if (line.compare(0, collected, seats_[i].name) == 0)
+                seats_[i].collected += ParseAmount(line.c_str() + collected + 11);
+        }
+    }
+}
+
+bool HandParser::Finish(PotShareCache &cache, PlayerResults &results)
+{
+    if (!started_ || !valid_ || num_seats_ < 2)
+        return false;
+
+    double total_put_in = 0, total_collected = 0;
+    for (int i = 0; i < num_seats_; i++)
+    {
+        total_put_in += seats_[i].put_in;
+        total_collected += seats_[i].collected;
+    }
+    if (total_put_in <= 0)
+        return false;
+
+    // The hand was all-in before the river if it reached a showdown of two
+    // or more players, none of whom acted once the last board cards were
+    // dealt, and all of whose cards are known.
+    int live[MAX_HISTORY_SEATS], num_live = 0;
+    bool all_shown = true;
+    for (int i = 0; i < num_seats_; i++)
+    {
+        if (!seats_[i].folded && seats_[i].put_in > 0)
+        {
+            live[num_live++] = i;
+            all_shown = all_shown && seats_[i].hole.GetCardCount() == 2;
+        }
+    }
+    bool allin = (num_live >= 2 && all_shown && board_at_last_action_ < 5 &&
+                  num_board_ == 5 && total_collected > 0);
+
+    double expected[MAX_HISTORY_SEATS] = { 0 };
+    if (allin)
+    {
+        // Build the main pot and side pots from the distinct amounts put in
+        // by the players still in. Each pot takes up to its level from
+        // every player, folded or not, and is contested by the players
+        // still in who put in at least that level.
+        double levels[MAX_HISTORY_SEATS];
+        for (int k = 0; k < num_live; k++)
+            levels[k] = seats_[live[k]].put_in;
+        std::sort(levels, levels + num_live);
+        int num_levels = (int)(std::unique(levels, levels + num_live) - levels);
+
+        uint32_t pot_players[MAX_HISTORY_SEATS];
+        double pot_amount[MAX_HISTORY_SEATS];
+        double below = 0;
+        for (int k = 0; k < num_levels; k++)
+        {
+            pot_amount[k] = 0;
+            for (int i = 0; i < num_seats_; i++)
+            {
+                double put_in = seats_[i].put_in;
+                pot_amount[k] += std::max(std::min(put_in, levels[k]) - below, 0.0);
+            }
+            pot_players[k] = 0;
+            for (int j = 0; j < num_live; j++)
+            {
+                if (seats_[live[j]].put_in >= levels[k])
+                    pot_players[k] |= 1U << j;
+            }
+            below = levels[k];
+        }
+        // Money put in above the highest level of the players still in
+        // belongs to a folded player's bet that nobody matched; it goes to
+        // the top pot.
+        for (int i = 0; i < num_seats_; i++)
+            pot_amount[num_levels - 1] += std::max(seats_[i].put_in - below, 0.0);
+
+        // Cards shown by players who folded are dead.
+        Hand holes[MAX_HISTORY_SEATS];
+        CardSet dead = 0;
+        for (int j = 0; j < num_live; j++)
+            holes[j] = seats_[live[j]].hole;
+        for (int i = 0; i < num_seats_; i++)
+        {
+            if (seats_[i].folded || seats_[i].put_in <= 0)
+                dead |= seats_[i].hole.GetCardSet();
+        }
+
+        Hand board = boards_[board_at_last_action_];
+        double shares[MAX_HISTORY_SEATS * MAX_HISTORY_SEATS];
+        if (!cache.GetPotShares(holes, num_live, board, dead & ~board.GetCardSet(),
+                                pot_players, num_levels, shares))
+            return false;
+
+        // The rake comes out of the pots in proportion.
+        double scale = total_collected / total_put_in;
+        for (int k = 0; k < num_levels; k++)
+        {
+            for (int j = 0; j < num_live; j++)
+                expected[live[j]] += scale * pot_amount[k] * shares[k * num_live + j];
+        }
+    }
+
+    for (int i = 0; i < num_seats_; i++)
+    {
+        const SeatState &seat = seats_[i];
+        PlayerResult &result = results[seat.name];
+        double net = seat.collected - seat.put_in;
+        bool in_allin = allin && !seat.folded;
+        result.num_hands++;
+        result.num_allins += in_allin;
+        result.net += net;
+        result.adjusted_net += in_allin? expected[i] - seat.put_in : net;
+    }
+    return true;
+}
+
+int64_t ProcessHandHistories(std::istream &in, PotShareCache &cache,
+                             PlayerResults &results)
+{
+    HandParser parser;
+    int64_t num_hands = 0;
+    std::string line;
+    bool first_line = true;
+    for (;;)
+    {
+        bool more = (bool)std::getline(in, line);
+        if (more && !line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        // The files usually start with a UTF-8 byte order mark.
+        if (more && first_line && StartsWith(line, "\xEF\xBB\xBF"))
+            line.erase(0, 3);
+        first_line = false;
+
+        // Hands are separated by blank lines.
+        if (!more || line.empty())
+        {
+            if (parser.IsStarted() && parser.Finish(cache, results))
+                ++num_hands;
+            parser.Reset();
+            if (!more)
+                break;
+            continue;
+        }
+        parser.ParseLine(line);
+    }
+    return num_hands;
+}
+
+int64_t ProcessHandHistoryFiles(const std::vector<std::string> &paths,
+                                PotShareCache &cache, PlayerResults &results)
+{
+    int num_threads = GetThreadCount();
+    std::vector<PlayerResults> thread_results(num_threads);
+    std::vector<int64_t> thread_hands(num_threads, 0);
+    std::atomic<size_t> next(0);
+    ParallelFor(num_threads, num_threads, [&](int thread, int64_t, int64_t)
+    {
+        for (;;)
+        {
+            size_t k = next.fetch_add(1);
+            if (k >= paths.size())
+                break;
+            std::ifstream in(paths[k].c_str(), std::ios::binary);
+            if (in)
+                thread_hands[thread] += ProcessHandHistories(in, cache, thread_results[thread]);
+        }
+    });
+
+    int64_t num_hands = 0;
+    for (int t = 0; t < num_threads; t++)
+    {
+        for (auto it = thread_results[t].begin(); it != thread_results[t].end(); ++it)
+            results[it->first].Merge(it->second);
+        num_hands += thread_hands[t];
+    }
+    return num_hands;
+}
@@ -0,0 +1,124 @@
+#ifndef HOLDEM_HISTORY_H
+#define HOLDEM_HISTORY_H
+
+#include "hand.h"
+#include <array>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Represents the results of one player over a set of hand histories.
+ *
+ * In a hand where the money went in before the river and the hole cards
+ * of everyone still in were shown, the all-in adjusted result replaces
+ * the amount actually won by the amount the player would win on average,
+ * i.e. the player's exact equity in each pot at the moment of the all-in.
+ * In every other hand both results are the same.
+ */
+struct PlayerResult
+{
+    int64_t num_hands;		/* hands dealt to the player */
+    int64_t num_allins;		/* all-in showdowns before the river */
+    double net;				/* amount won less the amount put in */
+    double adjusted_net;	/* all-in adjusted amount won less put in */
+
+    PlayerResult() : num_hands(0), num_allins(0), net(0), adjusted_net(0) { }
+
+    void Merge(const PlayerResult &a)
+    {
+        num_hands += a.num_hands;
+        num_allins += a.num_allins;
+        net += a.net;
+        adjusted_net += a.adjusted_net;
+    }
+};
+
+/// Represents the results of all the players, by player name.
+typedef std::map<std::string, PlayerResult> PlayerResults;
+
+/// Maximum number of seats at a table in a hand history.
+#define MAX_HISTORY_SEATS 10
+
+/// Number of 64-bit words of a PotShareCache key: the hole cards of each
+/// seat, the board, the dead cards, the masks of up to MAX_HISTORY_SEATS
+/// pots packed four to a word, and the numbers of players and pots.
+#define POT_SHARE_KEY_WORDS (MAX_HISTORY_SEATS + 6)
+
+/// Default maximum number of entries of a PotShareCache.
+#define DEFAULT_POT_SHARE_CACHE_SIZE (1 << 18)
+
+typedef std::array<uint64_t, POT_SHARE_KEY_WORDS> PotShareKey;
+
+/// Hashes a PotShareKey by folding its words with a multiply and a rotate.
+struct PotShareKeyHash
+{
+    size_t operator () (const PotShareKey &key) const
+    {
+        uint64_t h = 0;
+        for (uint64_t w : key)
+        {
+            h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+            h = (h << 29) | (h >> 35);
+        }
+        return (size_t)h;
+    }
+};
+
+/**
+ * Caches the pot shares of all-in showdowns, since the same matchups recur
+ * throughout an archive. A showdown is stored under the smallest of its 24
+ * suit permutations, so that matchups that only differ by a renaming of the
+ * suits share an entry. The key is a fixed-size array built on the stack.
+ *
+ * The cache holds at most max_entries entries; once full, an arbitrary
+ * entry is evicted for each new one, so the memory stays bounded however
+ * long the archive. The cache is safe to use from several threads.
+ */
+class PotShareCache
+{
+public:
+    explicit PotShareCache(size_t max_entries = DEFAULT_POT_SHARE_CACHE_SIZE)
+        : max_entries_(max_entries), num_lookups_(0), num_hits_(0) { }
+
+    /**
+     * Computes the shares of each player in each pot, as EnumeratePotShares,
+     * or returns them from the cache. Returns false if the input is invalid.
+     */
+    bool GetPotShares(const Hand *holes, int num_players, const Hand &board,
+                      CardSet dead, const uint32_t *pot_players, int num_pots,
+                      double *shares);
+
+    /// Returns the number of lookups and the number of cache hits.
+    int64_t GetLookupCount() const { return num_lookups_; }
+    int64_t GetHitCount() const { return num_hits_; }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<PotShareKey, std::vector<double>, PotShareKeyHash> entries_;
+    size_t max_entries_;
+    int64_t num_lookups_;
+    int64_t num_hits_;
+};
+
+/**
+ * Reads PokerStars hold'em hand histories from a stream, one hand at a time,
+ * and adds the results of each player to results. Hands that are not
+ * hold'em, or that cannot be parsed, are skipped. Returns the number of
+ * hands processed.
+ */
+int64_t ProcessHandHistories(std::istream &in, PotShareCache &cache,
+                             PlayerResults &results);
+
+/**
+ * Processes a list of hand history files in parallel, one file per thread
+ * at a time, and merges the results. Files that cannot be opened are
+ * skipped. Returns the number of hands processed.
+ */
+int64_t ProcessHandHistoryFiles(const std::vector<std::string> &paths,
+                                PotShareCache &cache, PlayerResults &results);
+
+#endif /* HOLDEM_HISTORY_H */
@@ -0,0 +1,212 @@
+#include "interactive.h"
+#include "board.h"
+#include "deck.h"
+#include <algorithm>
+#include <cmath>
+
+void LatencyHistogram::Clear()
+{
+    std::fill(counts_, counts_ + sizeof(counts_) / sizeof(counts_[0]), 0);
+    count_ = 0;
+    max_ = 0;
+}
+
+uint64_t LatencyHistogram::GetBucketEnd(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return (uint64_t)bucket;
+    int high = bucket / LATENCY_SUB_BUCKETS + 3;
+    uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+    uint64_t width = 1ULL << (high - 4);
+    return ((LATENCY_SUB_BUCKETS + sub) << (high - 4)) + (width - 1);
+}
+
+int64_t LatencyHistogram::GetPercentile(double fraction) const
+{
+    if (count_ == 0)
+        return 0;
+    int64_t rank = (int64_t)std::ceil(fraction * count_);
+    rank = std::max<int64_t>(1, std::min(rank, count_));
+    int64_t seen = 0;
+    for (int b = 0; ; b++)
+    {
+        seen += counts_[b];
+        if (seen >= rank)
+            return (int64_t)std::min(GetBucketEnd(b), max_);
+    }
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &a)
+{
+    for (size_t b = 0; b < sizeof(counts_) / sizeof(counts_[0]); b++)
+        counts_[b] += a.counts_[b];
+    count_ += a.count_;
+    max_ = std::max(max_, a.max_);
+}
+
+/// Returns the number of nanoseconds from start to now.
+static int64_t GetElapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+InteractiveEquity::InteractiveEquity(std::chrono::nanoseconds budget, unsigned int seed)
+    : budget_ns_(budget.count()), ns_per_evaluation_(0), engine_(seed)
+{
+    GetComboTables();
+
+    // Calibrate the cost model on a turn against every combo, which also
+    // builds the rank sum table and warms it up.
+    hero_ = Hand(Card('A', 's')) + Hand(Card('K', 's'));
+    board_ = Hand(Card('Q', 's')) + Hand(Card('7', 'd')) + Hand(Card('2', 'h')) +
+             Hand(Card('9', 'c'));
+    CardSet known = (hero_ + board_).GetCardSet();
+    Deck deck(known);
+    num_deck_ = deck.num_cards;
+    std::copy(deck.cards, deck.cards + deck.num_cards, deck_);
+    num_combos_ = 0;
+    for (int c = 0; c < NUM_COMBOS; c++)
+    {
+        if ((GetComboHand(c).value & known) == 0)
+            combos_[num_combos_++] = GetComboHand(c);
+    }
+
+    InteractiveResult result;
+    Enumerate(1, result);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; i++)
+        Enumerate(1, result);
+    double evaluations = 4 * (num_deck_ + (double)num_combos_ * (num_deck_ - 2));
+    ns_per_evaluation_ = GetElapsedNanoseconds(start) / evaluations;
+}
+
+bool InteractiveEquity::Compute(const InteractiveQuery &query, InteractiveResult &result)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Check the known cards, which must not overlap.
+    int num_board = query.board.GetCardCount();
+    CardSet hero = query.hero.GetCardSet();
+    CardSet board = query.board.GetCardSet();
+    if (query.hero.GetCardCount() != 2 || (num_board != 0 && num_board < 3) ||
+        num_board > 5 || (hero & board) || ((hero | board) & query.dead))
+        return false;
+    CardSet known = hero | board | query.dead;
+
+    hero_ = query.hero;
+    board_ = query.board;
+    num_combos_ = 0;
+    for (int i = 0; i < query.villain.num_combos; i++)
+    {
+        const Hand &combo = query.villain.combos[i];
+        if (combo.GetCardCount() == 2 && (combo.value & known) == 0)
+            combos_[num_combos_++] = combo;
+    }
+    if (num_combos_ == 0)
+        return false;
+    Deck deck(known);
+    num_deck_ = deck.num_cards;
+    std::copy(deck.cards, deck.cards + deck.num_cards, deck_);
+
+    // The exact enumeration evaluates the hero once per runout, and each
+    // combo on every runout that does not hold its cards.
+    int num_missing = 5 - num_board;
+    double evaluations = Choose(num_deck_, num_missing) +
+                         num_combos_ * Choose(num_deck_ - 2, num_missing);
+    result.predicted_ns = (int64_t)(evaluations * ns_per_evaluation_);
+    if (result.predicted_ns <= budget_ns_ / 2)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        Enumerate(num_missing, result);
+
+        // Refine the cost of an evaluation from queries big enough to time.
+        if (evaluations >= 10000)
+        {
+            double cost = GetElapsedNanoseconds(begin) / evaluations;
+            ns_per_evaluation_ = 0.9 * ns_per_evaluation_ + 0.1 * cost;
+        }
+    }
+    else
+    {
+        Sample(num_missing, start + std::chrono::nanoseconds(budget_ns_ * 9 / 10), result);
+    }
+
+    result.latency_ns = GetElapsedNanoseconds(start);
+    latencies_.Record(result.latency_ns);
+    return true;
+}
+
+void InteractiveEquity::Enumerate(int num_missing, InteractiveResult &result)
+{
+    double total = 0;
+    int64_t num_matchups = 0;
+    ForEachCombination(num_deck_, num_missing, [&](const int *indices)
+    {
+        Hand runout;
+        for (int i = 0; i < num_missing; i++)
+            runout += deck_[indices[i]];
+        CardSet runout_cards = runout.GetCardSet();
+        BoardContext context(board_ + runout);
+        HandStrength hero = context.Evaluate(hero_);
+        for (int c = 0; c < num_combos_; c++)
+        {
+            if (combos_[c].value & runout_cards)
+                continue;
+            HandStrength villain = context.Evaluate(combos_[c]);
+            total += (hero > villain)? 1.0 : (hero == villain)? 0.5 : 0.0;
+            ++num_matchups;
+        }
+    });
+
+    result.equity = total / num_matchups;
+    result.std_error = 0;
+    result.exact = true;
+    result.num_matchups = num_matchups;
+}
+
+void InteractiveEquity::Sample(int num_missing,
+                               std::chrono::steady_clock::time_point deadline,
+                               InteractiveResult &result)
+{
+    // Each sample picks a villain combo, then deals the runout from the
+    // cards it does not hold, by a partial Fisher-Yates shuffle that draws
+    // again whenever it lands on a villain card.
+    double sum = 0, sum_squares = 0;
+    int64_t n = 0;
+    do
+    {
+        for (int s = 0; s < 64; s++)
+        {
+            uint64_t r = engine_();
+            const Hand &villain = combos_[((r >> 32) * (uint64_t)num_combos_) >> 32];
+            CardSet villain_cards = villain.GetCardSet();
+            Hand runout;
+            for (int i = 0; i < num_missing; i++)
+            {
+                int j;
+                do
+                {
+                    uint64_t remaining = (uint64_t)(num_deck_ - i);
+                    j = i + (int)(((engine_() >> 32) * remaining) >> 32);
+                } while (deck_[j].value & villain_cards);
+                std::swap(deck_[i], deck_[j]);
+                runout += deck_[i];
+            }
+
+            Hand board = board_ + runout;
+            HandStrength hero = EvaluateHand(board + hero_);
+            HandStrength other = EvaluateHand(board + villain);
+            double share = (hero > other)? 1.0 : (hero == other)? 0.5 : 0.0;
+            sum += share;
+            sum_squares += share * share;
+        }
+        n += 64;
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    double mean = sum / n;
+    result.equity = mean;
+    result.std_error = std::sqrt(std::max(0.0, sum_squares / n - mean * mean) / n);
+    result.exact = false;
+    result.num_matchups = n;
+}
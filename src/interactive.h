@@ -0,0 +1,147 @@
+#ifndef HOLDEM_INTERACTIVE_H
+#define HOLDEM_INTERACTIVE_H
+
+#include "combo.h"
+#include "outs.h"
+#include <chrono>
+#include <random>
+#include <stdint.h>
+
+/// Number of buckets per power of two in a LatencyHistogram.
+#define LATENCY_SUB_BUCKETS 16
+
+/**
+ * Counts latencies in nanoseconds in log-linear buckets: each power of two
+ * is split into 16 buckets, so a percentile is within about 6% of the true
+ * value, over the whole range from 1 ns to centuries. Recording is a bit
+ * scan and an increment, and the histogram never allocates.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { Clear(); }
+
+    void Clear();
+
+    /// Counts one latency.
+    void Record(int64_t nanoseconds)
+    {
+        uint64_t v = (nanoseconds > 0)? (uint64_t)nanoseconds : 0;
+        ++counts_[GetBucket(v)];
+        ++count_;
+        if (v > max_)
+            max_ = v;
+    }
+
+    /// Returns the number of latencies recorded.
+    int64_t GetCount() const { return count_; }
+
+    /// Returns the largest latency recorded.
+    int64_t GetMax() const { return (int64_t)max_; }
+
+    /**
+     * Returns the latency below which the given fraction of the latencies
+     * fall, e.g. 0.99 for the p99: the upper bound of the bucket holding
+     * that rank, capped at the largest latency. Returns 0 if empty.
+     */
+    int64_t GetPercentile(double fraction) const;
+
+    /// Adds the counts of another histogram.
+    void Merge(const LatencyHistogram &a);
+
+private:
+    /// Values below 16 have a bucket each; above, a bucket is the position
+    /// of the highest bit and the next four bits.
+    static int GetBucket(uint64_t v)
+    {
+        if (v < LATENCY_SUB_BUCKETS)
+            return (int)v;
+        int high = intrinsic::bit_scan_reverse(v);
+        int sub = (int)(v >> (high - 4)) & (LATENCY_SUB_BUCKETS - 1);
+        return (high - 3) * LATENCY_SUB_BUCKETS + sub;
+    }
+
+    static uint64_t GetBucketEnd(int bucket);
+
+    int64_t counts_[61 * LATENCY_SUB_BUCKETS];
+    int64_t count_;
+    uint64_t max_;
+};
+
+/// Represents a single equity query: a hero hand against one opponent,
+/// whose hole cards are known or given as a range.
+struct InteractiveQuery
+{
+    Hand hero;					/* hero's hole cards */
+    HoleRange villain;			/* one combo for a known hand */
+    Hand board;					/* zero or three to five known cards */
+    CardSet dead;				/* cards known to be out of play */
+};
+
+/// Represents the answer to an InteractiveQuery.
+struct InteractiveResult
+{
+    double equity;				/* hero's share of the pot */
+    double std_error;			/* zero if exact */
+    bool exact;					/* true if every matchup was enumerated */
+    int64_t num_matchups;		/* (runout, villain combo) pairs settled */
+    int64_t predicted_ns;		/* the cost model's estimate of exact work */
+    int64_t latency_ns;			/* time spent answering */
+};
+
+/**
+ * Answers single equity queries with a bounded latency, for interactive
+ * use such as a live advisor with a time budget per decision.
+ *
+ * Everything runs in the calling thread: the engine never starts a thread
+ * nor allocates during a query. The tables it uses (the rank sum table of
+ * BoardContext and the combo tables) are built by the constructor, so the
+ * first query does not pay for them either.
+ *
+ * A query either enumerates every pair of a runout and a villain combo,
+ * which gives the exact equity, or samples such pairs at random until its
+ * budget is spent. A cost model picks between the two: the number of
+ * evaluations of the exact enumeration, known from the card counts, times
+ * the measured cost of an evaluation. The enumeration is chosen if it is
+ * predicted to take at most half the budget. The cost of an evaluation is
+ * calibrated by the constructor and refined after every exact query, so
+ * the model follows the machine and its load.
+ *
+ * The latency of every query is recorded in a histogram.
+ */
+class InteractiveEquity
+{
+public:
+    explicit InteractiveEquity(std::chrono::nanoseconds budget = std::chrono::milliseconds(1),
+                               unsigned int seed = 1);
+
+    /// Answers a query. Returns false if the cards are invalid or no
+    /// villain combo is consistent with the known cards.
+    bool Compute(const InteractiveQuery &query, InteractiveResult &result);
+
+    /// Returns the latencies of the queries answered so far.
+    const LatencyHistogram& GetLatencies() const { return latencies_; }
+
+    /// Returns the current estimate of the cost of one evaluation.
+    double GetEvaluationCost() const { return ns_per_evaluation_; }
+
+private:
+    void Enumerate(int num_missing, InteractiveResult &result);
+    void Sample(int num_missing, std::chrono::steady_clock::time_point deadline,
+                InteractiveResult &result);
+
+    int64_t budget_ns_;
+    double ns_per_evaluation_;
+    std::mt19937_64 engine_;
+    LatencyHistogram latencies_;
+
+    // Scratch state of the current query.
+    Hand hero_;
+    Hand board_;
+    Hand deck_[52];
+    int num_deck_;
+    Hand combos_[NUM_COMBOS];
+    int num_combos_;
+};
+
+#endif /* HOLDEM_INTERACTIVE_H */
@@ -177,9 +177,18 @@ inline int bit_scan_reverse(unsigned long long x)
 }
 #endif // defined(_WIN64)
 #else  // defined(_WIN32)
-DELEGATE_INTRINSIC(int, bit_scan_reverse, unsigned int, __builtin_clz)
-DELEGATE_INTRINSIC(int, bit_scan_reverse, unsigned long, __builtin_clzl)
-DELEGATE_INTRINSIC(int, bit_scan_reverse, unsigned long long, __builtin_clzll)
+inline int bit_scan_reverse(unsigned int x)
+{
+	return 31 - __builtin_clz(x);
+}
+inline int bit_scan_reverse(unsigned long x)
+{
+	return (int)sizeof(unsigned long)*8 - 1 - __builtin_clzl(x);
+}
+inline int bit_scan_reverse(unsigned long long x)
+{
+	return 63 - __builtin_clzll(x);
+}
 DELEGATE_INTRINSIC_CAST(int, bit_scan_reverse, unsigned char, unsigned int)
 DELEGATE_INTRINSIC_CAST(int, bit_scan_reverse, unsigned short, unsigned int)
 #endif // defined(_WIN32)
@@ -192,6 +201,17 @@ DELEGATE_INTRINSIC_CAST(int, bit_scan_reverse, long,        unsigned long)
 DELEGATE_INTRINSIC_CAST(int, bit_scan_reverse, long long,   unsigned long long)
 // @endcond
 
+/// Hints the processor to fetch the cache line holding an address, so that
+/// a later load from it does not wait for memory. Never faults.
+inline void prefetch(const void *p)
+{
+#if defined(_WIN32)
+	_mm_prefetch((const char *)p, _MM_HINT_T0);
+#else
+	__builtin_prefetch(p);
+#endif
+}
+
 } // namespace intrinsic
 
 #endif // INTRINSIC_HPP
@@ -0,0 +1,305 @@
+#include "isomorphism.h"
+#include "intrinsic.hpp"
+#include <algorithm>
+#include <vector>
+
+/// Number of board cards on each street.
+static const int street_board_cards[NUM_STREETS] = { 0, 3, 4, 5 };
+
+/**
+ * Represents a configuration: the shapes of the four suits, sorted. A
+ * shape holds the number of hole cards of a suit times eight plus its
+ * number of board cards.
+ */
+struct Configuration
+{
+    int64_t offset;				/* index of its first class */
+    int num_groups;				/* number of distinct shapes */
+    int group_end[4];			/* sorted position after each group */
+    int shape[4];				/* shape of each group */
+    uint64_t suit_count[4];		/* number of suit indices of each shape */
+    uint64_t group_count[4];	/* number of multisets of each group */
+    int position_k[4];			/* rank of each sorted position in its group */
+    uint64_t position_radix[4];	/* radix of the group of each position */
+};
+
+struct IsomorphismTables
+{
+    uint32_t choose[14][8];						/* C(n, k) for the ranks */
+    uint16_t colex[1 << 13];					/* colex index of a rank mask */
+    std::vector<uint32_t> keys[NUM_STREETS];	/* sorted shapes, 8 bits each */
+    std::vector<Configuration> configurations[NUM_STREETS];
+    int64_t count[NUM_STREETS];
+};
+
+/// Returns C(n, k) for n possibly larger than the number of ranks.
+static uint64_t Binomial(uint64_t n, int k)
+{
+    if ((uint64_t)k > n)
+        return 0;
+    if (k == 1)
+        return n;
+    if (k == 2)
+        return n * (n - 1) / 2;
+    uint64_t c = 1;
+    for (int i = 0; i < k; i++)
+        c = c * (n - i) / (i + 1);
+    return c;
+}
+
+/// Lists the configuration keys of a street by giving each suit in turn
+/// a shape no greater than the one before, out of the cards left.
+static void ListConfigurations(int suit, int max_shape, int hole_left,
+                               int board_left, uint32_t key,
+                               std::vector<uint32_t> &keys)
+{
+    if (suit == 4)
+    {
+        if (hole_left == 0 && board_left == 0)
+            keys.push_back(key);
+        return;
+    }
+    for (int h = hole_left; h >= 0; h--)
+    {
+        for (int b = board_left; b >= 0; b--)
+        {
+            int shape = h * 8 + b;
+            if (shape <= max_shape)
+            {
+                ListConfigurations(suit + 1, shape, hole_left - h, board_left - b,
+                                   key | (shape << (8 * (3 - suit))), keys);
+            }
+        }
+    }
+}
+
+static IsomorphismTables* CreateIsomorphismTables()
+{
+    IsomorphismTables *t = new IsomorphismTables;
+    for (int n = 0; n <= 13; n++)
+    {
+        for (int k = 0; k < 8; k++)
+            t->choose[n][k] = (uint32_t)Binomial(n, k);
+    }
+    for (uint32_t m = 0; m < (1 << 13); m++)
+    {
+        uint32_t colex = 0;
+        int i = 1;
+        for (uint32_t b = m; b != 0; b &= b - 1, i++)
+            colex += t->choose[intrinsic::bit_scan_forward(b)][i];
+        t->colex[m] = (uint16_t)colex;
+    }
+
+    for (int street = 0; street < NUM_STREETS; street++)
+    {
+        std::vector<uint32_t> &keys = t->keys[street];
+        ListConfigurations(0, 0xFF, 2, street_board_cards[street], 0, keys);
+        std::sort(keys.begin(), keys.end());
+
+        int64_t offset = 0;
+        for (uint32_t key : keys)
+        {
+            Configuration c;
+            c.offset = offset;
+            c.num_groups = 0;
+            for (int p = 0; p < 4; p++)
+            {
+                int shape = (key >> (8 * (3 - p))) & 0xFF;
+                if (c.num_groups == 0 || c.shape[c.num_groups - 1] != shape)
+                {
+                    int h = shape >> 3, b = shape & 7;
+                    c.shape[c.num_groups] = shape;
+                    c.suit_count[c.num_groups] = t->choose[13][h] * t->choose[13 - h][b];
+                    c.num_groups++;
+                }
+                c.group_end[c.num_groups - 1] = p + 1;
+            }
+
+            uint64_t size = 1;
+            for (int g = 0; g < c.num_groups; g++)
+            {
+                int begin = g? c.group_end[g - 1] : 0;
+                int n = c.group_end[g] - begin;
+                c.group_count[g] = Binomial(c.suit_count[g] + n - 1, n);
+                for (int p = begin; p < c.group_end[g]; p++)
+                {
+                    c.position_k[p] = c.group_end[g] - p;
+                    c.position_radix[p] = size;
+                }
+                size *= c.group_count[g];
+            }
+            t->configurations[street].push_back(c);
+            offset += (int64_t)size;
+        }
+        t->count[street] = offset;
+    }
+    return t;
+}
+
+static const IsomorphismTables& GetIsomorphismTables()
+{
+    static const IsomorphismTables *tables = CreateIsomorphismTables();
+    return *tables;
+}
+
+int64_t GetIsomorphicCount(int street)
+{
+    return GetIsomorphismTables().count[street];
+}
+
+int64_t GetIsomorphicIndex(const Hand &hole, const Hand &board)
+{
+    const IsomorphismTables &t = GetIsomorphismTables();
+    int num_board = board.GetCardCount();
+    int street = (num_board == 0)? Street_Preflop : num_board - 2;
+
+    // Find the shape and suit index of each suit, packed so that sorting
+    // them sorts by shape, then suit index. The board ranks of a suit are
+    // numbered among the ranks that are not its hole cards, by squeezing
+    // the (at most two) hole ranks out of the board mask, the higher one
+    // first; squeezing out a zero bit leaves the mask as it is.
+    uint64_t suits[4];
+    for (int s = 0; s < 4; s++)
+    {
+        uint32_t h = (uint32_t)(hole.value >> (16 * s)) & 0x1FFF;
+        uint32_t b = (uint32_t)(board.value >> (16 * s)) & 0x1FFF;
+        int num_hole = (int)(hole.value >> (16 * s + 13)) & 7;
+        int num_board = (int)(board.value >> (16 * s + 13)) & 7;
+        uint32_t high = (h & (h - 1)) - 1;
+        b = (b & high) | ((b >> 1) & ~high);
+        uint32_t low = (h & (0 - h)) - 1;
+        b = (b & low) | ((b >> 1) & ~low);
+        uint64_t index = t.colex[h] + (uint64_t)t.choose[13][num_hole] * t.colex[b];
+        suits[s] = ((uint64_t)(num_hole * 8 + num_board) << 32) | index;
+    }
+
+    // Sort the suits in descending order with a sorting network. The
+    // order of the suits is random, so the swaps are done with masks
+    // rather than branches.
+    static const int network[5][2] = { { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 } };
+    for (int i = 0; i < 5; i++)
+    {
+        uint64_t a = suits[network[i][0]], b = suits[network[i][1]];
+        uint64_t swap = (a ^ b) & (0 - (uint64_t)(a < b));
+        suits[network[i][0]] = a ^ swap;
+        suits[network[i][1]] = b ^ swap;
+    }
+
+    // Find the configuration with a binary search that does not branch.
+    uint32_t key = 0;
+    for (int p = 0; p < 4; p++)
+        key |= (uint32_t)(suits[p] >> 32) << (8 * (3 - p));
+    const uint32_t *keys = &t.keys[street][0];
+    size_t n = t.keys[street].size();
+    const uint32_t *first = keys;
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        first = (first[half] <= key)? first + half : first;
+        n -= half;
+    }
+    const Configuration &c = t.configurations[street][first - keys];
+
+    // Each group holds its suit indices in descending order; number the
+    // multiset through the strictly increasing sequence a[i] + i, i.e. add
+    // C(a + k - 1, k) for the suit index a of the k-th last suit of each
+    // group. The division by k! is exact, so it is done as a shift and a
+    // multiplication by the inverse of 3 modulo 2^64.
+    static const int factorial_shift[5] = { 0, 0, 1, 1, 3 };
+    static const uint64_t factorial_inverse[5] = {
+        1, 1, 1, 0xAAAAAAAAAAAAAAABULL, 0xAAAAAAAAAAAAAAABULL
+    };
+    int64_t index = c.offset;
+    for (int p = 0; p < 4; p++)
+    {
+        uint64_t a = suits[p] & 0xFFFFFFFF;
+        int k = c.position_k[p];
+        uint64_t product = a;
+        for (int j = 1; j < 4; j++)
+            product *= (j < k)? a + j : 1;
+        uint64_t multiset = (product >> factorial_shift[k]) * factorial_inverse[k];
+        index += (int64_t)(multiset * c.position_radix[p]);
+    }
+    return index;
+}
+
+/// Returns the largest n in [lo, hi] such that C(n, k) <= x, given that
+/// C(lo, k) <= x.
+static uint64_t FindBinomial(uint64_t x, int k, uint64_t lo, uint64_t hi)
+{
+    if (k == 1)
+        return x;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if (Binomial(mid, k) <= x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/// Returns the k-subset of [0, n) with the given colex index as a mask.
+static uint32_t UnrankColex(const IsomorphismTables &t, uint32_t colex, int n, int k)
+{
+    uint32_t m = 0;
+    for (int i = k; i >= 1; i--)
+    {
+        int pos = i - 1;
+        while (pos + 1 < n && t.choose[pos + 1][i] <= colex)
+            ++pos;
+        colex -= t.choose[pos][i];
+        m |= 1U << pos;
+    }
+    return m;
+}
+
+void GetIsomorphicHand(int64_t index, int street, Hand &hole, Hand &board)
+{
+    const IsomorphismTables &t = GetIsomorphismTables();
+    const std::vector<Configuration> &list = t.configurations[street];
+    const Configuration &c = *(std::upper_bound(list.begin(), list.end(), index,
+        [](int64_t i, const Configuration &a) { return i < a.offset; }) - 1);
+
+    // Recover the shape and suit index of each sorted position.
+    uint64_t rest = (uint64_t)(index - c.offset);
+    int shapes[4];
+    uint64_t suits[4];
+    int begin = 0;
+    for (int g = 0; g < c.num_groups; g++)
+    {
+        int end = c.group_end[g];
+        uint64_t multiset = rest % c.group_count[g];
+        rest /= c.group_count[g];
+        for (int i = end - begin; i >= 1; i--)
+        {
+            uint64_t n = FindBinomial(multiset, i, i - 1, c.suit_count[g] + i - 2);
+            multiset -= Binomial(n, i);
+            suits[end - i] = n - (i - 1);
+            shapes[end - i] = c.shape[g];
+        }
+        begin = end;
+    }
+
+    // Unrank the hole ranks of each suit, then its board ranks among the
+    // others, spreading them back around the hole ranks.
+    hole = Hand();
+    board = Hand();
+    for (int p = 0; p < 4; p++)
+    {
+        int num_hole = shapes[p] >> 3;
+        int num_board = shapes[p] & 7;
+        uint32_t size = t.choose[13][num_hole];
+        uint32_t h = UnrankColex(t, (uint32_t)(suits[p] % size), 13, num_hole);
+        uint32_t b = UnrankColex(t, (uint32_t)(suits[p] / size), 13 - num_hole, num_board);
+        for (uint32_t x = h; x != 0; x &= x - 1)
+        {
+            int rank = intrinsic::bit_scan_forward(x);
+            uint32_t low = (1U << rank) - 1;
+            b = (b & low) | ((b & ~low) << 1);
+        }
+        hole.value += ((uint64_t)((num_hole << 13) | h)) << (16 * p);
+        board.value += ((uint64_t)((num_board << 13) | b)) << (16 * p);
+    }
+}
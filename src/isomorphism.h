@@ -0,0 +1,59 @@
+#ifndef HOLDEM_ISOMORPHISM_H
+#define HOLDEM_ISOMORPHISM_H
+
+#include "hand.h"
+#include <stdint.h>
+
+/// Identifies the rounds of cards in hold'em.
+enum Street
+{
+    Street_Preflop = 0,	/* two hole cards */
+    Street_Flop = 1,	/* plus three board cards */
+    Street_Turn = 2,	/* plus one */
+    Street_River = 3	/* plus one */
+};
+
+#define NUM_STREETS 4
+
+/**
+ * Maps hole cards and a board to a dense index over their classes up to
+ * suit renaming, so that per-situation tables (equity, buckets,
+ * strategies) need one entry per class. The street follows from the
+ * number of board cards (0, 3, 4 or 5), and the order in which the board
+ * cards came does not matter. Two hands fall in the same class if renaming
+ * the suits turns the hole cards and the board of one into those of the
+ * other; there are 169 classes preflop, 1,286,792 on the flop, 13,960,050
+ * on the turn and 123,156,254 on the river.
+ *
+ * The index is built from the suit lanes of the hands:
+ *
+ *   - each suit has a shape, its number of hole cards and board cards, and
+ *     a suit index, which numbers its hole ranks and then its board ranks
+ *     among the others, in colex order;
+ *   - the suits are sorted by shape and suit index, which makes the hand
+ *     canonical, and the sorted shapes make up the configuration of the
+ *     hand, which a table maps to the offset of its classes;
+ *   - the suits of equal shape hold a multiset of suit indices, which has
+ *     a colex index, and the indices of these groups combine in mixed
+ *     radix after the offset.
+ *
+ * Unindexing reverses each step.
+ */
+
+/// Returns the number of classes of a street.
+int64_t GetIsomorphicCount(int street);
+
+/**
+ * Returns the class index in [0, GetIsomorphicCount(street)) of two hole
+ * cards and a board of zero or three to five cards, with no card in both.
+ */
+int64_t GetIsomorphicIndex(const Hand &hole, const Hand &board);
+
+/**
+ * Stores the hole cards and the board of the canonical hand of a class of
+ * a street. The canonical hand has the same index, and its suits come in
+ * the order of their sorted suit indices.
+ */
+void GetIsomorphicHand(int64_t index, int street, Hand &hole, Hand &board);
+
+#endif /* HOLDEM_ISOMORPHISM_H */
@@ -2,9 +2,30 @@
 #include <random>
 #include <functional>
 #include "hand.h"
+#include "arena.h"
+#include "board.h"
+#include "combo.h"
+#include "equity.h"
+#include "history.h"
+#include "interactive.h"
+#include "lanes.h"
+#include "outs.h"
+#include "parallel.h"
+#include "sampling.h"
+#include "selfplay.h"
+#include "server.h"
+#include "shuffle.h"
+#include "strength_index.h"
 #include <algorithm>
 #include <stdint.h>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #if 0
 extern void test();
@@ -44,50 +65,114 @@ hand_t find_best_hand(const card_t cards[7], HandStrength *strength_output)
 }
 #endif
 
-#define HOLE_CARD_COMBINATIONS 169
+#define MAX_PLAYERS 10
+
+// Keep track of the number of occurrences and winning of each combination
+// of hole cards.
+struct hole_stat_t
+{
+	char type[4];  // e.g. "AKs"
+	int64_t num_occur[MAX_PLAYERS]; // number of occurrence given n opponents
+	int64_t num_win[MAX_PLAYERS];   // number of winning given n opponents
+	double odds(int num_players) const 
+	{
+		return (double)(num_occur[num_players] - num_win[num_players])
+            / num_win[num_players];
+	}
+};
+
+void init_hole_stats(hole_stat_t stat[NUM_HOLE_CLASSES])
+{
+	for (int i = 0; i < NUM_HOLE_CLASSES; i++)
+	{
+		FormatHoleClass(stat[i].type, i);
+		memset(stat[i].num_occur, 0, sizeof(stat[i].num_occur));
+		memset(stat[i].num_win, 0, sizeof(stat[i].num_win));
+	}
+}
 
-/// Computes an index for two hole cards, only accounting for rank and 
-/// suited-ness. The index is computed as follows:
-/// 23s, 23o, 24s, 24o, ..., 2As, 2Ao
-/// 34s, 34o, 35s, 35o, ..., 3As, 3Ao
-/// ...
-/// KAs, KAo
-/// 22, 33, ..., AA
-/// There are in total 2*(12+11+...+1)+13=169 combinations.
-/// This can also be viewed as drawing two cards (a,b) from 1..13 randomly.
-/// If a = b, this maps to a pair (off-suit); if a < b, this maps to off-suit;
-/// if a > b, this maps to same-suit.
-int compute_hole_index(const Hand &hand)
+// Settle one deal and store, for each number of players j+1, whether the
+// hole cards of player j are the best so far.
+void find_leaders(const Hand &community, const Hand *holes, int num_players,
+                  bool leader[MAX_PLAYERS])
 {
-    Card cards[2];
-    hand.GetCards(cards);
+	// Store the winning hand.
+    HandStrength win_strength;
+
+    BoardContext board(community);
+    bool use_bound = board.IsFlushPossible() && !board.IsPaired();
 
-	int r1 = cards[0].rank, r2 = cards[1].rank;
-	if (r1 > r2) // make sure r1 <= r2
-		std::swap(r1, r2);
+	for (int j = 0; j < num_players; j++)
+	{
+        const Hand &hole = holes[j];
+		leader[j] = false;
 
-	if (cards[0].suit == cards[1].suit) // same-suit
-		return r2 * 13 + r1;
-	else
-		return r1 * 13 + r2;
+		// Skip the evaluation if this player cannot reach the category
+		// of the best hand so far, as it can neither win nor tie.
+		// (See ResolveShowdown for when the bound pays off.)
+		if (use_bound && j > 0 && 
+			board.GetUpperBound(hole) < win_strength.GetCategory())
+			continue;
+
+		// Find the best 5-card combination from these 7 cards.
+        HandStrength strength = board.Evaluate(hole);
+
+		// Update the winning hand for a game with j+1 players.
+		if (j == 0 || strength > win_strength)
+		{
+            win_strength = strength;
+			leader[j] = true;
+		}
+	}
+
+	// Note that we do not process tie here. This needs to be fixed.
 }
 
-void format_hole_index(char s[4], int index)
+// Settle one deal and record, for each number of players j+1, the hole
+// cards of player j and whether they are the best so far.
+void play_deal(const Hand &community, const Hand *holes, int num_players,
+               hole_stat_t stat[NUM_HOLE_CLASSES])
 {
-	int r1 = index / 13, r2 = index % 13;
-	s[0] = format_rank((Rank)std::max(r1, r2));
-	s[1] = format_rank((Rank)std::min(r1, r2));
-	s[2] = (r1 == r2)? ' ' : (r1 > r2)? 's' : 'o';
-	s[3] = 0;
+	bool leader[MAX_PLAYERS];
+	find_leaders(community, holes, num_players, leader);
+	for (int j = 0; j < num_players; j++)
+	{
+		int hole_class = GetHoleClass(holes[j]);
+		stat[hole_class].num_occur[j]++;
+		stat[hole_class].num_win[j] += leader[j];
+	}
 }
 
-#define MAX_PLAYERS 10
+void print_hole_stats(const hole_stat_t stat[NUM_HOLE_CLASSES], int num_players)
+{
+	printf("r1 r2 s Hole");
+	for (int n = 2; n <= num_players; n++)
+	{
+		printf(" %6d", n);
+	}
+	printf("\n");
+	for (int hole = 0; hole < 169; hole++)
+	{
+		char t = stat[hole].type[2];
+		printf("%2d %2d %c %s ", hole / 13, hole % 13, 
+			(t == ' ')? 'p' : t, stat[hole].type);
+		for (int n = 2; n <= num_players; n++)
+		{
+			double prob = (double)stat[hole].num_win[n-1] / stat[hole].num_occur[n-1];
+			printf(" %.4lf", prob);
+		}
+		printf("\n");
+	}
+	//printf("----------------\n");
+}
 
 // Run a Monte-Carlo simulation of a game with 6 players.
 // Simulate 1,000,000 games.
 // Record the winning hole cards of each game.
 // Then count the winning frequency of each hole cards.
-void simulate(int num_players, int num_simulations)
+// Except in plain mode, the cards in use are dealt by a DealSampler.
+void simulate(int num_players, int num_simulations, 
+              SamplingMode mode = Sampling_Plain)
 {
 	std::mt19937 engine;
 	//std::uniform_int_distribution<int> d(0, 51);
@@ -95,26 +180,8 @@ void simulate(int num_players, int num_simulations)
 		return std::uniform_int_distribution<int>(0, n - 1)(engine);
 	};
 
-	// Keep track of the number of occurrences and winning of each combination
-	// of hole cards.
-	struct hole_stat_t
-	{
-		char type[4];  // e.g. "AKs"
-		int num_occur[MAX_PLAYERS]; // number of occurrence given n opponents
-		int num_win[MAX_PLAYERS];   // number of winning given n opponents
-		double odds(int num_players) const 
-		{
-			return (double)(num_occur[num_players] - num_win[num_players])
-                / num_win[num_players];
-		}
-	};
-	hole_stat_t stat[HOLE_CARD_COMBINATIONS];
-	for (int i = 0; i < HOLE_CARD_COMBINATIONS; i++)
-	{
-		format_hole_index(stat[i].type, i);
-		memset(stat[i].num_occur, 0, sizeof(stat[i].num_occur));
-		memset(stat[i].num_win, 0, sizeof(stat[i].num_win));
-	}
+	hole_stat_t stat[NUM_HOLE_CLASSES];
+	init_hole_stats(stat);
 
 	// Initialize a deck of cards.
 	Hand deck[52];
@@ -123,62 +190,31 @@ void simulate(int num_players, int num_simulations)
         Card card((Rank)(i / 4), (Suit)(i % 4));
         deck[i] = Hand(card);
 	}
+	Deck sorted_deck;
+	DealSampler sampler(mode, 5 + 2 * num_players, 0);
 
 	for (int i = 0; i < num_simulations; i++)
 	{
 		// Shuffle the deck.
-		std::random_shuffle(deck + 0, deck + 52, gen);
-
-		// Store the winning hand and hole cards.
-        HandStrength win_strength;
-
-		// Use the first five cards as community cards.
-        Hand community(deck, 5);
-
-		// Use each of the next two cards as hole cards for the players.
-		for (int j = 0; j < num_players; j++)
+		if (mode == Sampling_Plain)
 		{
-            Hand hole;
-            hole += deck[5 + j * 2];
-			hole += deck[5 + j * 2 + 1];
-
-			// Update the occurrence of this combination of hole cards.
-			stat[compute_hole_index(hole)].num_occur[j]++;
-
-			// Find the best 5-card combination from these 7 cards.
-            HandStrength strength = EvaluateHand(community + hole);
-
-			// Update the winning hand statistics for a game with j+1 players.
-			if (j == 0 || strength > win_strength)
-			{
-                win_strength = strength;
-				stat[compute_hole_index(hole)].num_win[j]++;
-			}
+			// In the same order as std::random_shuffle, which C++20 lacks.
+			for (int k = 1; k < 52; k++)
+				std::swap(deck[k], deck[gen(k + 1)]);
 		}
+		else
+			sampler.Deal(sorted_deck, deck);
 
-		// Note that we do not process tie here. This needs to be fixed.
+		// Use the first five cards as community cards, and each of the next
+		// two cards as hole cards for the players.
+		Hand holes[MAX_PLAYERS];
+		for (int j = 0; j < num_players; j++)
+			holes[j] = deck[5 + j * 2] + deck[5 + j * 2 + 1];
+		play_deal(Hand(deck, 5), holes, num_players, stat);
 	}
 
 #if 1
-	printf("r1 r2 s Hole");
-	for (int n = 2; n <= num_players; n++)
-	{
-		printf(" %6d", n);
-	}
-	printf("\n");
-	for (int hole = 0; hole < 169; hole++)
-	{
-		char t = stat[hole].type[2];
-		printf("%2d %2d %c %s ", hole / 13, hole % 13, 
-			(t == ' ')? 'p' : t, stat[hole].type);
-		for (int n = 2; n <= num_players; n++)
-		{
-			double prob = (double)stat[hole].num_win[n-1] / stat[hole].num_occur[n-1];
-			printf(" %.4lf", prob);
-		}
-		printf("\n");
-	}
-	//printf("----------------\n");
+	print_hole_stats(stat, num_players);
 #endif
 
 #if 0
@@ -210,7 +246,7 @@ void simulate(int num_players, int num_simulations)
 
 #if 0
 	// Sort the statistics by winning count (strongest hand first).
-	std::sort(stat, stat + HOLE_CARD_COMBINATIONS,
+	std::sort(stat, stat + NUM_HOLE_CLASSES,
 		[](const hole_stat_t &s1, const hole_stat_t &s2) -> bool 
 	{
 		double p1 = (double)s1.num_win / (s1.num_occur + 0.0001);
@@ -219,7 +255,7 @@ void simulate(int num_players, int num_simulations)
 	});
 	
 	// Display statistics.
-	for (int i = 0; i < HOLE_CARD_COMBINATIONS; i++)
+	for (int i = 0; i < NUM_HOLE_CLASSES; i++)
 	{
 		double percentage = 100.0 * stat[i].num_win / (stat[i].num_occur + 0.0001);
 		// printf("%s %.2lf%%\n", stat[i].type, percentage);
@@ -229,8 +265,438 @@ void simulate(int num_players, int num_simulations)
 
 }
 
-int main()
+// Tallies the hole cards of the simulations of N lanes in a private
+// sub-histogram per lane: the lane is the last index, so the N increments
+// of a batch never hit the same counter, even when two lanes deal the same
+// hole class, and need no conflict detection. Each counter takes at most
+// one increment per batch, so 16 bits hold a block of up to 65535 batches.
+template <int N>
+struct lane_hole_tally_t
+{
+	uint16_t num_occur[MAX_PLAYERS][NUM_HOLE_CLASSES][N];
+	uint16_t num_win[MAX_PLAYERS][NUM_HOLE_CLASSES][N];
+
+	void clear()
+	{
+		memset(num_occur, 0, sizeof(num_occur));
+		memset(num_win, 0, sizeof(num_win));
+	}
+
+	// Add the counts of all the lanes into the 64-bit counters of stat.
+	void flush(hole_stat_t stat[NUM_HOLE_CLASSES], int num_players)
+	{
+		for (int j = 0; j < num_players; j++)
+		{
+			for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+			{
+				int64_t occur = 0, win = 0;
+				for (int l = 0; l < N; l++)
+				{
+					occur += num_occur[j][c][l];
+					win += num_win[j][c][l];
+				}
+				stat[c].num_occur[j] += occur;
+				stat[c].num_win[j] += win;
+			}
+		}
+		clear();
+	}
+};
+
+// Same as simulate, but deals the cards of eight simulations at a time, one
+// per lane of a LaneDealer, instead of shuffling the deck for each, and
+// tallies them in per-lane sub-histograms flushed once per block.
+void simulate_batched(int num_players, int num_simulations)
 {
+	const int num_lanes = 8;
+	const int block_batches = 4096;
+	hole_stat_t stat[NUM_HOLE_CLASSES];
+	init_hole_stats(stat);
+	ArenaScope scope;
+	lane_hole_tally_t<num_lanes> &tally = *scope.New<lane_hole_tally_t<num_lanes>>(1);
+	tally.clear();
+
+	LaneDealer<num_lanes> dealer((Deck()), 1);
+	Hand cards[52 * num_lanes];
+	int num_cards = 5 + 2 * num_players;
+	int num_batches = 0;
+	for (int i = 0; i < num_simulations; i += num_lanes)
+	{
+		dealer.Deal(num_cards, cards);
+		int n = std::min(num_lanes, num_simulations - i);
+		int classes[MAX_PLAYERS][num_lanes];
+		bool leaders[num_lanes][MAX_PLAYERS];
+		for (int l = 0; l < n; l++)
+		{
+			Hand community;
+			for (int c = 0; c < 5; c++)
+				community += cards[c * num_lanes + l];
+			Hand holes[MAX_PLAYERS];
+			for (int j = 0; j < num_players; j++)
+			{
+				holes[j] = cards[(5 + j * 2) * num_lanes + l] + 
+				           cards[(5 + j * 2 + 1) * num_lanes + l];
+				classes[j][l] = GetHoleClass(holes[j]);
+			}
+			find_leaders(community, holes, num_players, leaders[l]);
+		}
+
+		for (int j = 0; j < num_players; j++)
+		{
+			for (int l = 0; l < n; l++)
+			{
+				tally.num_occur[j][classes[j][l]][l]++;
+				tally.num_win[j][classes[j][l]][l] += leaders[l][j];
+			}
+		}
+		if (++num_batches == block_batches)
+		{
+			tally.flush(stat, num_players);
+			num_batches = 0;
+		}
+	}
+	tally.flush(stat, num_players);
+
+	print_hole_stats(stat, num_players);
+}
+
+// Compare the sampling modes on the preflop equity of a few hands against
+// random opponents, and show how many times fewer deals each mode needs for
+// the same standard error as plain sampling. The estimates adjusted by the
+// heads-up control variate are shown alongside.
+void compare_sampling(int num_trials)
+{
+	const char *hands[] = { "AsAh", "AsKs", "JhTh", "7c2d" };
+	printf("Hand Opp Mode       Equity  StdErr  Reduction  Adjusted  StdErr\n");
+	for (int num_opponents = 1; num_opponents <= 5; num_opponents += 2)
+	{
+		for (size_t i = 0; i < sizeof(hands) / sizeof(hands[0]); i++)
+		{
+			const char *s = hands[i];
+			Hand hero = Hand(Card(s[0], s[1])) + Hand(Card(s[2], s[3]));
+			for (int mode = Sampling_Plain; mode <= Sampling_Sobol; mode++)
+			{
+				EquityEstimate e;
+				EstimateEquity(hero, Hand(), 0, num_opponents, num_trials,
+					(SamplingMode)mode, 1, e, true);
+				printf("%s %3d %-10s %.4lf  %.4lf  %9.2lf  %.4lf    %.4lf\n", 
+					s, num_opponents, GetSamplingModeName((SamplingMode)mode), 
+					e.equity, e.std_error, e.variance_reduction, 
+					e.adjusted_equity, e.adjusted_std_error);
+			}
+		}
+	}
+}
+
+// Write num_deals shuffles of cards_per_deal cards from the given seed to a
+// binary file, one byte per card, and show the rate.
+void write_deals(int64_t num_deals, int cards_per_deal, uint64_t seed, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = WriteDeals(file, DealGenerator(seed), 0, num_deals, cards_per_deal, 
+	                     GetThreadCount());
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	fclose(file);
+	if (!ok)
+	{
+		fprintf(stderr, "cannot write %s\n", path);
+		return;
+	}
+	printf("%lld deals of %d cards, seed %llu, %.1lf million deals per second\n",
+		(long long)num_deals, cards_per_deal, (unsigned long long)seed,
+		num_deals / seconds / 1e6);
+}
+
+// Check the generator of the deals against its known answers, and run the
+// statistical tests on num_deals shuffles from the given seed.
+void test_deals(int64_t num_deals, uint64_t seed)
+{
+	printf("Philox known answers: %s\n", VerifyPhilox()? "pass" : "FAIL");
+	DealTestResult results[NUM_DEAL_TESTS];
+	RunDealTests(DealGenerator(seed), 0, num_deals, GetThreadCount(), results);
+	printf("Test        ChiSquare  DoF  p-value\n");
+	for (int i = 0; i < NUM_DEAL_TESTS; i++)
+	{
+		printf("%-10s %10.1lf %5d  %.4lf\n", results[i].name, results[i].chi_square,
+			results[i].degrees_of_freedom, results[i].p_value);
+	}
+}
+
+// Answer random single queries as a live advisor would, within a budget of
+// 2 ms each, on every street against a known hand or a range, and print
+// the latency percentiles.
+void run_interactive(int num_queries)
+{
+	const char *classes[] = { "AA", "KK", "QQ", "JJ", "TT", "99", "88", "77",
+		"AKs", "AKo", "AQs" };
+	std::vector<Hand> range;
+	for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+	{
+		char name[4];
+		FormatHoleClass(name, c);
+		if (std::find_if(std::begin(classes), std::end(classes),
+			[&](const char *s) { return strcmp(s, name) == 0; }) == std::end(classes))
+			continue;
+		const uint16_t *combos;
+		int num_combos = GetClassCombos(c, &combos);
+		for (int i = 0; i < num_combos; i++)
+			range.push_back(GetComboHand(combos[i]));
+	}
+
+	InteractiveEquity engine(std::chrono::milliseconds(2));
+	std::mt19937 engine_deal(1);
+	const int board_sizes[4] = { 0, 3, 4, 5 };
+	int num_exact = 0;
+	double max_error = 0;
+	for (int i = 0; i < num_queries; i++)
+	{
+		Deck deck;
+		deck.Deal(engine_deal, 9);
+		Hand villain = deck.cards[2] + deck.cards[3];
+		InteractiveQuery query;
+		query.hero = deck.cards[0] + deck.cards[1];
+		query.villain.combos = (i % 2 == 0)? &villain : range.data();
+		query.villain.num_combos = (i % 2 == 0)? 1 : (int)range.size();
+		query.board = Hand(deck.cards + 4, board_sizes[i / 2 % 4]);
+		query.dead = 0;
+
+		InteractiveResult result;
+		if (!engine.Compute(query, result))
+			continue;
+		if (result.exact)
+			++num_exact;
+		else
+			max_error = std::max(max_error, result.std_error);
+	}
+
+	const LatencyHistogram &latencies = engine.GetLatencies();
+	printf("%lld queries, %d exact, largest standard error %.4lf\n",
+		(long long)latencies.GetCount(), num_exact, max_error);
+	printf("Latency p50 %.3lf ms, p99 %.3lf ms, p999 %.3lf ms, max %.3lf ms\n",
+		latencies.GetPercentile(0.5) * 1e-6, latencies.GetPercentile(0.99) * 1e-6,
+		latencies.GetPercentile(0.999) * 1e-6, latencies.GetMax() * 1e-6);
+	printf("%.2lf ns per evaluation\n", engine.GetEvaluationCost());
+}
+
+// Read PokerStars hand history files and print the all-in adjusted results
+// of each player.
+void report_allin_ev(const std::vector<std::string> &paths)
+{
+	PotShareCache cache;
+	PlayerResults results;
+	int64_t num_hands = ProcessHandHistoryFiles(paths, cache, results);
+
+	printf("%-24s %8s %7s %12s %12s %12s\n", "Player", "Hands", "All-in", 
+		"Net", "Adjusted", "Luck");
+	for (auto it = results.begin(); it != results.end(); ++it)
+	{
+		const PlayerResult &r = it->second;
+		printf("%-24s %8lld %7lld %12.2lf %12.2lf %12.2lf\n", it->first.c_str(),
+			(long long)r.num_hands, (long long)r.num_allins, r.net, 
+			r.adjusted_net, r.net - r.adjusted_net);
+	}
+	printf("%lld hands, %lld all-in lookups, %lld cached\n", (long long)num_hands,
+		(long long)cache.GetLookupCount(), (long long)cache.GetHitCount());
+}
+
+// Play hands between agents of increasing looseness and print the win rate
+// of each agent by position, and of each class of hole cards by position,
+// in big blinds per 100 hands.
+void run_selfplay(int64_t num_hands)
+{
+	const int num_players = 6;
+	const double fractions[num_players][2] = {
+		{ 0.08, 0.04 }, { 0.12, 0.06 }, { 0.18, 0.10 }, 
+		{ 0.25, 0.15 }, { 0.40, 0.25 }, { 0.60, 0.40 } };
+	PreflopStrategy strategies[num_players];
+	for (int a = 0; a < num_players; a++)
+		strategies[a] = MakeThresholdStrategy(fractions[a][0], fractions[a][1]);
+
+	SelfPlayConfig config = { num_players, 0.5, 3.0, strategies };
+	SelfPlayResults results;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	SimulateSelfPlay(config, num_hands, 1, results);
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	printf("%lld hands, %lld showdowns, %.1lf million hands per minute\n",
+		(long long)results.num_hands, (long long)results.num_showdowns,
+		results.num_hands / seconds * 60 / 1e6);
+
+	printf("Agent Open  Call     SB     BB");
+	for (int p = 2; p < num_players; p++)
+		printf("    P%d ", p);
+	printf("  Total\n");
+	for (int a = 0; a < num_players; a++)
+	{
+		printf("%5d %4.0lf%% %4.0lf%%", a, fractions[a][0] * 100, fractions[a][1] * 100);
+		int64_t hands = 0;
+		double net = 0;
+		for (int p = 0; p < num_players; p++)
+		{
+			printf(" %6.1lf", 100 * results.agent_net[a][p] / results.agent_hands[a][p]);
+			hands += results.agent_hands[a][p];
+			net += results.agent_net[a][p];
+		}
+		printf(" %6.1lf\n", 100 * net / hands);
+	}
+
+	printf("Hole     SB     BB");
+	for (int p = 2; p < num_players; p++)
+		printf("    P%d ", p);
+	printf("\n");
+	for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+	{
+		char type[4];
+		FormatHoleClass(type, c);
+		printf("%s ", type);
+		for (int p = 0; p < num_players; p++)
+			printf(" %6.1lf", 100 * results.class_net[p][c] / results.class_hands[p][c]);
+		printf("\n");
+	}
+}
+
+// Answer equity queries read from stdin, one per line, until the end of the
+// input. A line is either "query " followed by a query in the format of
+// ParseEquityQuery, or "cancel <id>". Each answer is printed as a line with
+// the id, the status, the runouts settled and the equity of each player.
+void run_server(int num_loops)
+{
+	std::mutex output;
+	QueryServer server(num_loops, [&](const QueryResponse &r)
+	{
+		std::lock_guard<std::mutex> lock(output);
+		printf("%lld %s %lld/%lld", (long long)r.id, GetQueryStatusName(r.status),
+			(long long)r.num_deals, (long long)r.num_runouts);
+		for (int i = 0; i < r.num_players && r.status != Query_Invalid; i++)
+			printf(" %.4lf", r.equity[i]);
+		printf("\n");
+		fflush(stdout);
+	});
+
+	std::string line;
+	while (std::getline(std::cin, line))
+	{
+		if (line.compare(0, 6, "query ") == 0)
+		{
+			EquityQuery query;
+			if (ParseEquityQuery(line.c_str() + 6, query))
+			{
+				server.Submit(query);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(output);
+				printf("? invalid %s\n", line.c_str());
+				fflush(stdout);
+			}
+		}
+		else if (line.compare(0, 7, "cancel ") == 0)
+		{
+			server.Cancel(atoll(line.c_str() + 7));
+		}
+	}
+	server.Drain();
+}
+
+#if _DEBUG
+// Run each query twice and check that the second run, once the arenas,
+// the tables and the thread pool are set up, makes no heap allocation.
+void check_allocations()
+{
+	Hand hero = Hand(Card('A', 's')) + Hand(Card('K', 's'));
+	Hand villain = Hand(Card('Q', 'd')) + Hand(Card('Q', 'c'));
+	Hand holes[2] = { hero, villain };
+	Hand flop = Hand(Card('Q', 's')) + Hand(Card('7', 's')) + Hand(Card('2', 'h'));
+	Hand turn = flop + Hand(Card('3', 'd'));
+	Hand river = turn + Hand(Card('9', 'c'));
+	const uint32_t pot_players[1] = { 3 };
+	HoleRange range = { &villain, 1 };
+	DoubleBoardHand double_board = { holes, 2, { turn, turn }, 0 };
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int64_t count = GetHeapAllocationCount();
+
+		EquityEstimate estimate;
+		EstimateEquity(hero, flop, 0, 2, 1000, Sampling_Sobol, 1, estimate);
+		TimedEquity timed;
+		ComputeEquityByDeadline(holes, 2, turn, 0, 
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(1), 1, timed);
+		double shares[2];
+		EnumeratePotShares(holes, 2, flop, 0, pot_players, 1, shares);
+		DoubleBoardEquity equity[2];
+		EnumerateDoubleBoardEquity(double_board, equity);
+		SimulateDoubleBoardEquity(double_board, 1000, 1, equity);
+		OutsResult outs;
+		ComputeOuts(hero, flop, &range, 1, 0, outs);
+		BoardStrengthIndex index(river);
+
+		count = GetHeapAllocationCount() - count;
+		if (pass == 1 && count != 0)
+			fprintf(stderr, "%lld heap allocations in the query paths\n", (long long)count);
+		assert(pass == 0 || count == 0);
+	}
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#if _DEBUG
+	check_allocations();
+#endif
+
+	if (argc > 1 && strcmp(argv[1], "sampling") == 0)
+	{
+		compare_sampling((argc > 2)? atoi(argv[2]) : 160000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "batched") == 0)
+	{
+		simulate_batched(8, (argc > 2)? atoi(argv[2]) : 1000000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "server") == 0)
+	{
+		run_server((argc > 2)? atoi(argv[2]) : GetThreadCount());
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "selfplay") == 0)
+	{
+		run_selfplay((argc > 2)? atoll(argv[2]) : 10000000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "deals") == 0)
+	{
+		write_deals((argc > 2)? atoll(argv[2]) : 10000000,
+		            (argc > 3)? atoi(argv[3]) : 52,
+		            (argc > 4)? strtoull(argv[4], NULL, 0) : 1,
+		            (argc > 5)? argv[5] : "deals.bin");
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "dealtest") == 0)
+	{
+		test_deals((argc > 2)? atoll(argv[2]) : 10000000,
+		           (argc > 3)? strtoull(argv[3], NULL, 0) : 1);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "interactive") == 0)
+	{
+		run_interactive((argc > 2)? atoi(argv[2]) : 10000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "allin") == 0)
+	{
+		report_allin_ev(std::vector<std::string>(argv + 2, argv + argc));
+		return 0;
+	}
+
 #if _DEBUG
 	simulate(4, 10000);
 #else
@@ -0,0 +1,159 @@
+#include "outs.h"
+#include "arena.h"
+#include "board.h"
+#include "deck.h"
+#include <algorithm>
+
+#define MAX_OUTS_OPPONENTS 9
+
+/**
+ * Lists every assignment of combinations to the opponents that uses no card
+ * twice and no known card. Each assignment is a row of num_opponents hands
+ * in 'hands', and the union of its cards goes to 'used'. If hands is null,
+ * the rows are only counted. Returns the number of rows so far.
+ */
+static size_t ListMatchups(const HoleRange *opponents, int num_opponents,
+                           int level, Hand *row, CardSet taken,
+                           Hand *hands, CardSet *used, size_t num_rows)
+{
+    if (level == num_opponents)
+    {
+        if (hands)
+        {
+            std::copy(row, row + num_opponents, hands + num_rows * num_opponents);
+            used[num_rows] = taken;
+        }
+        return num_rows + 1;
+    }
+    for (int i = 0; i < opponents[level].num_combos; i++)
+    {
+        const Hand &combo = opponents[level].combos[i];
+        if ((combo.GetCardSet() & taken) != 0)
+            continue;
+        row[level] = combo;
+        num_rows = ListMatchups(opponents, num_opponents, level + 1, row,
+                                taken | combo.GetCardSet(), hands, used, num_rows);
+    }
+    return num_rows;
+}
+
+/// Returns the hero's share of the pot given the strengths of all hands.
+static double GetShare(HandStrength hero, const HandStrength *opponents,
+                       int num_opponents)
+{
+    int num_winners = 1;
+    for (int i = 0; i < num_opponents; i++)
+    {
+        if (opponents[i] > hero)
+            return 0.0;
+        num_winners += (opponents[i] == hero);
+    }
+    return 1.0 / num_winners;
+}
+
+bool ComputeOuts(const Hand &hero, const Hand &board,
+                 const HoleRange *opponents, int num_opponents,
+                 CardSet dead, OutsResult &result)
+{
+    int num_board = board.GetCardCount();
+    if (num_board < 3 || num_board > 4 || 
+        num_opponents < 1 || num_opponents > MAX_OUTS_OPPONENTS)
+        return false;
+
+    CardSet known = hero.GetCardSet() | board.GetCardSet() | dead;
+    // Count the matchups first, so that they can be listed in the arena.
+    ArenaScope scope;
+    Hand row[MAX_OUTS_OPPONENTS];
+    size_t num_rows = ListMatchups(opponents, num_opponents, 0, row, known, 
+                                   NULL, NULL, 0);
+    if (num_rows == 0)
+        return false;
+    Hand *hands = scope.New<Hand>(num_rows * num_opponents);
+    CardSet *used = scope.New<CardSet>(num_rows);
+    ListMatchups(opponents, num_opponents, 0, row, known, hands, used, 0);
+
+    // The share with the hands made so far (five or six cards).
+    HandStrength strengths[MAX_OUTS_OPPONENTS];
+    HandStrength hero_now = EvaluateHand(board + hero);
+    double share_now = 0;
+    for (size_t k = 0; k < num_rows; k++)
+    {
+        for (int i = 0; i < num_opponents; i++)
+            strengths[i] = EvaluateHand(board + hands[k * num_opponents + i]);
+        share_now += GetShare(hero_now, strengths, num_opponents);
+    }
+    share_now /= num_rows;
+
+    // Every (next card, matchup, river) triple that uses distinct cards is
+    // equally likely, so the current equity is the plain average over all
+    // of them.
+    Deck deck(known);
+    double total_equity = 0, total_count = 0;
+    result.num_cards = 0;
+    for (int c = 0; c < deck.num_cards; c++)
+    {
+        Hand next_board = board + deck.cards[c];
+        CardSet next_card = deck.cards[c].GetCardSet();
+        double share = 0, share_count = 0;
+        double equity = 0, equity_count = 0;
+
+        // The share with the hands made once this card is dealt.
+        HandStrength hero_next = EvaluateHand(next_board + hero);
+        for (size_t k = 0; k < num_rows; k++)
+        {
+            if (used[k] & next_card)
+                continue;
+            for (int i = 0; i < num_opponents; i++)
+                strengths[i] = EvaluateHand(next_board + hands[k * num_opponents + i]);
+            share += GetShare(hero_next, strengths, num_opponents);
+            share_count += 1;
+        }
+        if (share_count == 0)
+            continue;
+
+        if (num_board == 4)
+        {
+            // On the turn, the next card completes the board.
+            equity = share;
+            equity_count = share_count;
+        }
+        else
+        {
+            // On the flop, run out every river after the turn card; each
+            // complete board is shared by all the matchups.
+            for (int r = 0; r < deck.num_cards; r++)
+            {
+                if (r == c)
+                    continue;
+                BoardContext context(next_board + deck.cards[r]);
+                CardSet out = next_card | deck.cards[r].GetCardSet();
+                HandStrength hero_river = context.Evaluate(hero);
+                for (size_t k = 0; k < num_rows; k++)
+                {
+                    if (used[k] & out)
+                        continue;
+                    for (int i = 0; i < num_opponents; i++)
+                        strengths[i] = context.Evaluate(hands[k * num_opponents + i]);
+                    equity += GetShare(hero_river, strengths, num_opponents);
+                    equity_count += 1;
+                }
+            }
+        }
+
+        CardOutcome &outcome = result.cards[result.num_cards++];
+        Card card;
+        deck.cards[c].GetCards(&card);
+        outcome.card = card;
+        outcome.equity = equity / equity_count;
+        outcome.share = share / share_count;
+        outcome.flips = (outcome.share >= 0.5) != (share_now >= 0.5);
+        total_equity += equity;
+        total_count += equity_count;
+    }
+
+    result.equity = total_equity / total_count;
+    result.share = share_now;
+    for (int i = 0; i < result.num_cards; i++)
+        result.cards[i].change = result.cards[i].equity - result.equity;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef HOLDEM_OUTS_H
+#define HOLDEM_OUTS_H
+
+#include "hand.h"
+
+/// Represents the possible hole cards of an opponent, all equally likely.
+/// A known hand is a range with one combination.
+struct HoleRange
+{
+    const Hand *combos;
+    int num_combos;
+};
+
+/// Represents the effect of one possible next card on the hero's hand.
+struct CardOutcome
+{
+    Card card;
+    double equity;	/* hero's equity once this card is dealt */
+    double change;	/* equity with this card less the current equity */
+    double share;	/* hero's share of the pot with the hands made so far */
+    bool flips;		/* true if this card changes whether the hero is ahead */
+};
+
+/**
+ * Represents the outs of a hero hand on the flop or the turn.
+ *
+ * The hero is ahead if the hands made so far would win the hero at least
+ * half the pot (counting ties as a split), averaged over the opponent 
+ * ranges.
+ * A card flips the result if the hero is ahead before the card and not
+ * after, or vice versa; on the turn a flip is therefore an out (or a bad
+ * beat) in the usual sense.
+ */
+struct OutsResult
+{
+    double equity;	/* hero's equity before the next card */
+    double share;	/* hero's share with the hands made so far */
+    int num_cards;	/* number of possible next cards */
+    CardOutcome cards[52];
+};
+
+/**
+ * Computes the hero's equity for each possible next card on a flop or turn
+ * board, against one or more opponents given as ranges. Each opponent
+ * combination that holds the next card is dropped, so card removal is
+ * accounted for exactly. The hands are built incrementally: the board plus
+ * the next card (and the river, from the flop) forms a board context that
+ * all the players share.
+ *
+ * Returns false if the board does not have three or four cards, or if no
+ * combination of the opponents is consistent with the known cards.
+ */
+bool ComputeOuts(const Hand &hero, const Hand &board,
+                 const HoleRange *opponents, int num_opponents,
+                 CardSet dead, OutsResult &result);
+
+#endif /* HOLDEM_OUTS_H */
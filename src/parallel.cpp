@@ -0,0 +1,103 @@
+#include "parallel.h"
+#include <condition_variable>
+#include <mutex>
+
+/// Set on the threads of the pool, which must not wait for the pool.
+static thread_local bool is_pool_worker = false;
+
+/**
+ * Keeps a fixed set of worker threads waiting for jobs. Worker t runs task
+ * t of each job; the caller runs task 0 and waits for the others.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int num_workers)
+        : task_(NULL), context_(NULL), num_tasks_(0), generation_(0),
+          pending_(0), stop_(false)
+    {
+        workers_.reserve(num_workers);
+        for (int t = 1; t <= num_workers; t++)
+            workers_.push_back(std::thread(&ThreadPool::Work, this, t));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (size_t t = 0; t < workers_.size(); t++)
+            workers_[t].join();
+    }
+
+    bool Run(int num_tasks, void (*task)(void*, int), void *context)
+    {
+        if (is_pool_worker || num_tasks > (int)workers_.size() + 1)
+            return false;
+        std::unique_lock<std::mutex> job(job_mutex_, std::try_to_lock);
+        if (!job.owns_lock())
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = task;
+            context_ = context;
+            num_tasks_ = num_tasks;
+            pending_ = num_tasks - 1;
+            ++generation_;
+        }
+        start_.notify_all();
+
+        task(context, 0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+        return true;
+    }
+
+private:
+    void Work(int index)
+    {
+        is_pool_worker = true;
+        int64_t seen = 0;
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+            if (index >= num_tasks_)
+                continue;
+            void (*task)(void*, int) = task_;
+            void *context = context_;
+            lock.unlock();
+
+            task(context, index);
+
+            lock.lock();
+            if (--pending_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;				/* held by the caller of a job */
+    std::mutex mutex_;					/* guards the fields below */
+    std::condition_variable start_;		/* signals a new job or stop */
+    std::condition_variable done_;		/* signals the end of a job */
+    void (*task_)(void*, int);
+    void *context_;
+    int num_tasks_;
+    int64_t generation_;				/* number of jobs started */
+    int pending_;						/* tasks of the job still running */
+    bool stop_;
+};
+
+bool RunOnThreadPool(int num_tasks, void (*task)(void*, int), void *context)
+{
+    static ThreadPool pool(GetThreadCount() - 1);
+    return pool.Run(num_tasks, task, context);
+}
@@ -0,0 +1,78 @@
+#ifndef HOLDEM_PARALLEL_H
+#define HOLDEM_PARALLEL_H
+
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/// Returns the number of worker threads to use for parallel loops.
+inline int GetThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return (n == 0)? 1 : (int)n;
+}
+
+/**
+ * Runs task(context, t) for every t in [0, num_tasks), task 0 on the calling
+ * thread and the others on the workers of a pool that lives as long as the
+ * program, and returns when all are done. The pool is started on first use
+ * with GetThreadCount() - 1 workers, after which a job makes no allocation.
+ *
+ * Returns false without running anything if the pool cannot take the job:
+ * it has fewer threads than tasks, it is busy with the job of another
+ * thread, or the caller is one of its workers.
+ */
+bool RunOnThreadPool(int num_tasks, void (*task)(void*, int), void *context);
+
+/**
+ * Splits the range [0, count) into num_threads contiguous chunks and runs
+ * f(thread_index, begin, end) on each chunk in its own thread. The call
+ * returns when all chunks are done.
+ *
+ * Each invocation receives its thread index so that it can accumulate into
+ * thread-private state, which the caller merges afterwards; this keeps the
+ * inner loops free of locks and shared writes.
+ *
+ * The chunks run on the thread pool when it is free, and on threads
+ * started for this call otherwise (e.g. for a ParallelFor nested in
+ * another).
+ */
+template <class Func>
+void ParallelFor(int64_t count, int num_threads, Func f)
+{
+    if (num_threads > count)
+        num_threads = (int)count;
+    if (num_threads <= 1)
+    {
+        if (count > 0)
+            f(0, (int64_t)0, count);
+        return;
+    }
+
+    struct Job
+    {
+        Func *f;
+        int64_t count;
+        int num_threads;
+
+        static void Run(void *context, int t)
+        {
+            const Job &job = *static_cast<const Job*>(context);
+            int64_t begin = job.count * t / job.num_threads;
+            int64_t end = job.count * (t + 1) / job.num_threads;
+            (*job.f)(t, begin, end);
+        }
+    };
+    Job job = { &f, count, num_threads };
+    if (RunOnThreadPool(num_threads, &Job::Run, &job))
+        return;
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int t = 0; t < num_threads; t++)
+        threads.push_back(std::thread(&Job::Run, &job, t));
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+#endif /* HOLDEM_PARALLEL_H */
@@ -0,0 +1,155 @@
+#include "sampling.h"
+#include "intrinsic.hpp"
+#include <algorithm>
+#include <cassert>
+
+const char* GetSamplingModeName(SamplingMode mode)
+{
+    switch (mode)
+    {
+    case Sampling_Plain: return "plain";
+    case Sampling_Antithetic: return "antithetic";
+    case Sampling_Sobol: return "sobol";
+    }
+    return "unknown";
+}
+
+/**
+ * Primitive polynomials and initial direction numbers for dimensions 2 to
+ * 32, from the new-joe-kuo-6.21201 table of Joe and Kuo. The polynomial of
+ * degree s is x^s + a_1 x^(s-1) + ... + a_(s-1) x + 1, where a holds the
+ * bits a_1 ... a_(s-1). The first dimension is the van der Corput sequence
+ * and needs no entry.
+ */
+static const struct
+{
+    int s;
+    int a;
+    uint32_t m[7];
+} JoeKuo[MAX_SOBOL_DIMENSIONS - 1] =
+{
+    { 1,  0, { 1 } },
+    { 2,  1, { 1, 3 } },
+    { 3,  1, { 1, 3, 1 } },
+    { 3,  2, { 1, 1, 1 } },
+    { 4,  1, { 1, 1, 3, 3 } },
+    { 4,  4, { 1, 3, 5, 13 } },
+    { 5,  2, { 1, 1, 5, 5, 17 } },
+    { 5,  4, { 1, 1, 5, 5, 5 } },
+    { 5,  7, { 1, 1, 7, 11, 19 } },
+    { 5, 11, { 1, 1, 5, 1, 1 } },
+    { 5, 13, { 1, 1, 1, 3, 11 } },
+    { 5, 14, { 1, 3, 5, 5, 31 } },
+    { 6,  1, { 1, 3, 3, 9, 7, 49 } },
+    { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+    { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+    { 6, 19, { 1, 1, 1, 15, 7, 5 } },
+    { 6, 22, { 1, 3, 1, 15, 13, 25 } },
+    { 6, 25, { 1, 1, 5, 5, 19, 61 } },
+    { 7,  1, { 1, 3, 7, 11, 23, 15, 103 } },
+    { 7,  4, { 1, 3, 7, 13, 13, 15, 69 } },
+    { 7,  7, { 1, 1, 3, 13, 7, 35, 63 } },
+    { 7,  8, { 1, 3, 5, 9, 1, 25, 53 } },
+    { 7, 14, { 1, 3, 1, 13, 9, 35, 107 } },
+    { 7, 19, { 1, 3, 1, 5, 27, 61, 31 } },
+    { 7, 21, { 1, 1, 5, 11, 19, 41, 61 } },
+    { 7, 28, { 1, 3, 5, 3, 3, 13, 69 } },
+    { 7, 31, { 1, 1, 7, 13, 1, 19, 1 } },
+    { 7, 32, { 1, 3, 7, 5, 13, 19, 59 } },
+    { 7, 37, { 1, 1, 3, 9, 25, 29, 41 } },
+    { 7, 41, { 1, 3, 5, 13, 23, 1, 55 } },
+    { 7, 42, { 1, 3, 7, 3, 13, 59, 17 } },
+};
+
+SobolSequence::SobolSequence(int num_dimensions, uint32_t seed)
+    : num_dimensions_(num_dimensions), index_(0)
+{
+    assert(num_dimensions >= 1 && num_dimensions <= MAX_SOBOL_DIMENSIONS);
+
+    // The direction numbers are stored as 32-bit fractions, v[i] = m[i] /
+    // 2^(i+1), and follow the recurrence of the primitive polynomial.
+    for (int i = 0; i < 32; i++)
+        direction_[0][i] = 1U << (31 - i);
+    for (int d = 1; d < num_dimensions; d++)
+    {
+        int s = JoeKuo[d - 1].s, a = JoeKuo[d - 1].a;
+        uint32_t *v = direction_[d];
+        for (int i = 0; i < s; i++)
+            v[i] = JoeKuo[d - 1].m[i] << (31 - i);
+        for (int i = s; i < 32; i++)
+        {
+            v[i] = v[i - s] ^ (v[i - s] >> s);
+            for (int k = 1; k < s; k++)
+                v[i] ^= ((a >> (s - 1 - k)) & 1) * v[i - k];
+        }
+    }
+
+    std::mt19937 engine(seed);
+    for (int d = 0; d < num_dimensions; d++)
+        point_[d] = (uint32_t)engine();
+}
+
+const uint32_t* SobolSequence::Next()
+{
+    // The first point is the origin (shifted). Point i+1 differs from
+    // point i by the direction number of the lowest zero bit of i.
+    if (index_ > 0)
+    {
+        int c = intrinsic::bit_scan_forward(~(index_ - 1));
+        for (int d = 0; d < num_dimensions_; d++)
+            point_[d] ^= direction_[d][c];
+    }
+    ++index_;
+    return point_;
+}
+
+DealSampler::DealSampler(SamplingMode mode, int num_cards_to_deal, uint32_t seed)
+    : mode_(mode), k_(num_cards_to_deal), engine_(seed),
+      sobol_(std::min(std::max(num_cards_to_deal, 1), MAX_SOBOL_DIMENSIONS), seed),
+      mirror_next_(false)
+{
+    assert(mode != Sampling_Sobol || num_cards_to_deal <= MAX_SOBOL_DIMENSIONS);
+    for (int i = 0; i < 52; i++)
+        order_[i] = i;
+}
+
+void DealSampler::Deal(const Deck &deck, Hand *cards)
+{
+    int n = deck.num_cards;
+    assert(k_ <= n);
+
+    if (mode_ == Sampling_Antithetic && mirror_next_)
+    {
+        for (int i = 0; i < k_; i++)
+            cards[i] = deck.cards[n - 1 - last_[i]];
+        mirror_next_ = false;
+        return;
+    }
+
+    if (mode_ == Sampling_Sobol)
+    {
+        // Scale coordinate i to a choice among the n-i remaining cards, and
+        // undo the swaps afterwards so that every point starts from the
+        // same order.
+        const uint32_t *u = sobol_.Next();
+        for (int i = 0; i < k_; i++)
+        {
+            int j = i + (int)(((uint64_t)u[i] * (uint32_t)(n - i)) >> 32);
+            std::swap(order_[i], order_[j]);
+            last_[i] = j;
+            cards[i] = deck.cards[order_[i]];
+        }
+        for (int i = k_ - 1; i >= 0; i--)
+            std::swap(order_[i], order_[last_[i]]);
+        return;
+    }
+
+    for (int i = 0; i < k_; i++)
+    {
+        int j = std::uniform_int_distribution<int>(i, n - 1)(engine_);
+        std::swap(order_[i], order_[j]);
+        last_[i] = order_[i];
+        cards[i] = deck.cards[order_[i]];
+    }
+    mirror_next_ = (mode_ == Sampling_Antithetic);
+}
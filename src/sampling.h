@@ -0,0 +1,90 @@
+#ifndef HOLDEM_SAMPLING_H
+#define HOLDEM_SAMPLING_H
+
+#include "deck.h"
+#include <random>
+
+/// Selects how a Monte Carlo simulation deals its cards.
+enum SamplingMode
+{
+    Sampling_Plain = 0,      /* independent random deals */
+    Sampling_Antithetic = 1, /* pairs of mirrored deals */
+    Sampling_Sobol = 2       /* scrambled Sobol sequence */
+};
+
+/// Returns a short name of a sampling mode, e.g. "plain".
+const char* GetSamplingModeName(SamplingMode mode);
+
+#define MAX_SOBOL_DIMENSIONS 32
+
+/**
+ * Generates the points of a Sobol low-discrepancy sequence in up to 32
+ * dimensions, using the direction numbers of Joe and Kuo. The points are
+ * visited in Gray code order, so each point costs one XOR per dimension.
+ *
+ * The sequence is scrambled by a random digital shift: every coordinate
+ * is XOR-ed with a random 32-bit mask drawn from the seed. Each point is
+ * then uniformly distributed, while the points together still cover the
+ * unit cube much more evenly than random points do.
+ */
+class SobolSequence
+{
+public:
+    SobolSequence(int num_dimensions, uint32_t seed);
+
+    /**
+     * Advances to the next point and returns its coordinates, each a
+     * 32-bit binary fraction in [0, 1). At most 2^32 points can be drawn.
+     */
+    const uint32_t* Next();
+
+private:
+    int num_dimensions_;
+    uint32_t index_;
+    uint32_t direction_[MAX_SOBOL_DIMENSIONS][32];
+    uint32_t point_[MAX_SOBOL_DIMENSIONS];
+};
+
+/**
+ * Deals k cards at a time from the live cards of a deck. Every deal is
+ * uniformly distributed in all the modes, so each mode gives an unbiased
+ * estimate; they differ in how the deals are correlated.
+ *
+ * Sampling_Plain draws each deal independently with a partial Fisher-Yates
+ * shuffle, like Deck::Deal.
+ *
+ * Sampling_Antithetic returns each random deal followed by its mirror, in
+ * which each card is replaced by the card at the opposite end of the deck.
+ * The deck is ordered by rank and then by suit, so the mirror swaps high
+ * ranks for low ranks; a strong runout is paired with a weak one, and the
+ * average of the pair varies less than a single deal.
+ *
+ * Sampling_Sobol maps the next point of a scrambled Sobol sequence (one
+ * dimension per card) to the choices of the Fisher-Yates shuffle.
+ */
+class DealSampler
+{
+public:
+    DealSampler(SamplingMode mode, int num_cards_to_deal, uint32_t seed);
+
+    /// Returns the number of cards in each deal.
+    int GetDealSize() const { return k_; }
+
+    /**
+     * Deals the next k cards out of deck.cards and stores them in cards.
+     * The same deck must be passed to every call. The deck itself is not
+     * changed.
+     */
+    void Deal(const Deck &deck, Hand *cards);
+
+private:
+    SamplingMode mode_;
+    int k_;
+    std::mt19937 engine_;
+    SobolSequence sobol_;
+    int order_[52];           // positions in the deck, shuffled
+    int last_[52];            // positions of the last deal
+    bool mirror_next_;        // true if the next deal mirrors the last one
+};
+
+#endif /* HOLDEM_SAMPLING_H */
@@ -0,0 +1,281 @@
+#include "selfplay.h"
+#include "arena.h"
+#include "equity.h"
+#include "lanes.h"
+#include "parallel.h"
+#include <algorithm>
+
+PreflopStrategy MakeThresholdStrategy(double open_fraction, double call_fraction)
+{
+    // Rank the classes by their equity against one random hand.
+    double equity[NUM_HOLE_CLASSES];
+    int order[NUM_HOLE_CLASSES];
+    for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+    {
+        const uint16_t *combos;
+        GetClassCombos(c, &combos);
+        ComputeHeadsUpEquity(GetComboHand(combos[0]), Hand(), 0, equity[c]);
+        order[c] = c;
+    }
+    std::sort(order, order + NUM_HOLE_CLASSES,
+        [&](int a, int b) { return equity[a] > equity[b]; });
+
+    PreflopStrategy strategy;
+    int num_combos = 0;
+    for (int i = 0; i < NUM_HOLE_CLASSES; i++)
+    {
+        int c = order[i];
+        const uint16_t *combos;
+        num_combos += GetClassCombos(c, &combos);
+        double fraction = (double)num_combos / NUM_COMBOS;
+        strategy.open[c] = (fraction <= open_fraction)? Action_Raise : Action_Fold;
+        strategy.versus_raise[c] = (fraction <= call_fraction)? Action_Call : Action_Fold;
+    }
+    return strategy;
+}
+
+void SelfPlayResults::Clear()
+{
+    num_hands = 0;
+    num_showdowns = 0;
+    for (int a = 0; a < MAX_SELFPLAY_PLAYERS; a++)
+    {
+        for (int p = 0; p < MAX_SELFPLAY_PLAYERS; p++)
+        {
+            agent_hands[a][p] = 0;
+            agent_net[a][p] = 0;
+        }
+        for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+        {
+            class_hands[a][c] = 0;
+            class_net[a][c] = 0;
+        }
+    }
+}
+
+void SelfPlayResults::Merge(const SelfPlayResults &a)
+{
+    num_hands += a.num_hands;
+    num_showdowns += a.num_showdowns;
+    for (int i = 0; i < MAX_SELFPLAY_PLAYERS; i++)
+    {
+        for (int p = 0; p < MAX_SELFPLAY_PLAYERS; p++)
+        {
+            agent_hands[i][p] += a.agent_hands[i][p];
+            agent_net[i][p] += a.agent_net[i][p];
+        }
+        for (int c = 0; c < NUM_HOLE_CLASSES; c++)
+        {
+            class_hands[i][c] += a.class_hands[i][c];
+            class_net[i][c] += a.class_net[i][c];
+        }
+    }
+}
+
+/// Represents one hand between its preflop betting and its showdown.
+struct SelfPlayHand
+{
+    int first_agent;						/* agent in position 0 */
+    int classes[MAX_SELFPLAY_PLAYERS];		/* hole class by position */
+    double put_in[MAX_SELFPLAY_PLAYERS];	/* amount put in by position */
+    uint32_t live;							/* positions still in */
+    int first_strength;						/* index of the first strength */
+};
+
+/// Plays the preflop betting of a hand, given the hole class of each
+/// position, and fills in the amounts put in and the players left.
+static void PlayPreflop(const SelfPlayConfig &config, SelfPlayHand &hand)
+{
+    int n = config.num_players;
+    const PreflopStrategy *strategies = config.strategies;
+    for (int p = 0; p < n; p++)
+        hand.put_in[p] = 0;
+    hand.put_in[0] = config.small_blind;
+    hand.put_in[1] = 1.0;
+    hand.live = (1U << n) - 1;
+
+    // The first to act is in position 2 (or the small blind heads-up) and
+    // the big blind acts last.
+    int order[MAX_SELFPLAY_PLAYERS];
+    for (int i = 0; i < n; i++)
+        order[i] = (i + 2) % n;
+
+    double bet = 1.0;
+    int raiser = -1;
+    for (int i = 0; i < n; i++)
+    {
+        int p = order[i];
+        const PreflopStrategy &s = strategies[(hand.first_agent + p) % n];
+        int cls = hand.classes[p];
+        if (raiser < 0)
+        {
+            int action = s.open[cls];
+            if (action == Action_Raise)
+            {
+                bet = config.raise_size;
+                hand.put_in[p] = bet;
+                raiser = i;
+            }
+            else if (action == Action_Call || p == 1)
+            {
+                // The big blind checks rather than folds.
+                hand.put_in[p] = bet;
+            }
+            else
+            {
+                hand.live &= ~(1U << p);
+            }
+        }
+        else if (s.versus_raise[cls] != Action_Fold)
+        {
+            hand.put_in[p] = bet;
+        }
+        else
+        {
+            hand.live &= ~(1U << p);
+        }
+    }
+
+    // The players who limped before the raise act again.
+    for (int i = 0; i < raiser; i++)
+    {
+        int p = order[i];
+        if (((hand.live >> p) & 1) == 0)
+            continue;
+        const PreflopStrategy &s = strategies[(hand.first_agent + p) % n];
+        if (s.versus_raise[hand.classes[p]] != Action_Fold)
+            hand.put_in[p] = bet;
+        else
+            hand.live &= ~(1U << p);
+    }
+}
+
+/// Records the result of a hand given the share of the pot won by each
+/// position.
+static void RecordHand(const SelfPlayConfig &config, const SelfPlayHand &hand,
+                       const double *won, SelfPlayResults &results)
+{
+    int n = config.num_players;
+    for (int p = 0; p < n; p++)
+    {
+        int agent = (hand.first_agent + p) % n;
+        double net = won[p] - hand.put_in[p];
+        results.agent_hands[agent][p]++;
+        results.agent_net[agent][p] += net;
+        results.class_hands[p][hand.classes[p]]++;
+        results.class_net[p][hand.classes[p]] += net;
+    }
+    results.num_hands++;
+}
+
+bool SimulateSelfPlay(const SelfPlayConfig &config, int64_t num_hands,
+                      uint64_t seed, SelfPlayResults &results)
+{
+    const int num_lanes = 8;
+
+    int n = config.num_players;
+    if (n < 2 || n > MAX_SELFPLAY_PLAYERS || num_hands <= 0 ||
+        config.strategies == NULL)
+        return false;
+
+    ArenaScope scope;
+    int num_threads = GetThreadCount();
+    SelfPlayResults *tallies = scope.New<SelfPlayResults>(num_threads);
+    int64_t num_batches = (num_hands + num_lanes - 1) / num_lanes;
+    ParallelFor(num_batches, num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        SelfPlayResults &tally = tallies[thread];
+        LaneDealer<num_lanes> dealer((Deck()), seed + (uint64_t)thread * 0x9E3779B97F4A7C15ULL);
+        Hand cards[52 * num_lanes];
+        SelfPlayHand hands[num_lanes];
+        Hand showdown[num_lanes * MAX_SELFPLAY_PLAYERS];
+        HandStrength strengths[num_lanes * MAX_SELFPLAY_PLAYERS];
+        int num_cards = 5 + 2 * n;
+
+        for (int64_t b = begin; b < end; b++)
+        {
+            int lanes = (int)std::min<int64_t>(num_lanes, num_hands - b * num_lanes);
+            dealer.Deal(num_cards, cards);
+
+            // Play the preflop of each hand, and list the hands that go to
+            // a showdown for one batch evaluation.
+            int num_showdown = 0;
+            for (int l = 0; l < lanes; l++)
+            {
+                SelfPlayHand &hand = hands[l];
+                hand.first_agent = (int)((b * num_lanes + l) % n);
+                for (int p = 0; p < n; p++)
+                {
+                    Hand hole = cards[(5 + 2 * p) * num_lanes + l] +
+                                cards[(6 + 2 * p) * num_lanes + l];
+                    hand.classes[p] = GetHoleClass(hole);
+                }
+                PlayPreflop(config, hand);
+
+                hand.first_strength = num_showdown;
+                if (hand.live & (hand.live - 1))
+                {
+                    Hand board;
+                    for (int c = 0; c < 5; c++)
+                        board += cards[c * num_lanes + l];
+                    for (int p = 0; p < n; p++)
+                    {
+                        if ((hand.live >> p) & 1)
+                            showdown[num_showdown++] = board +
+                                cards[(5 + 2 * p) * num_lanes + l] +
+                                cards[(6 + 2 * p) * num_lanes + l];
+                    }
+                }
+            }
+            EvaluateHands(showdown, strengths, num_showdown);
+
+            // Split each pot among the best hands.
+            for (int l = 0; l < lanes; l++)
+            {
+                const SelfPlayHand &hand = hands[l];
+                double pot = 0;
+                double won[MAX_SELFPLAY_PLAYERS] = { 0 };
+                for (int p = 0; p < n; p++)
+                    pot += hand.put_in[p];
+
+                uint32_t winners = hand.live;
+                if (hand.live & (hand.live - 1))
+                {
+                    HandStrength best;
+                    winners = 0;
+                    int k = hand.first_strength;
+                    for (int p = 0; p < n; p++)
+                    {
+                        if (((hand.live >> p) & 1) == 0)
+                            continue;
+                        if (winners == 0 || strengths[k] > best)
+                        {
+                            best = strengths[k];
+                            winners = 1U << p;
+                        }
+                        else if (strengths[k] == best)
+                        {
+                            winners |= 1U << p;
+                        }
+                        ++k;
+                    }
+                    tally.num_showdowns++;
+                }
+
+                double share = pot / intrinsic::pop_count(winners);
+                for (int p = 0; p < n; p++)
+                {
+                    if ((winners >> p) & 1)
+                        won[p] = share;
+                }
+                RecordHand(config, hand, won, tally);
+            }
+        }
+    });
+
+    results.Clear();
+    for (int t = 0; t < num_threads; t++)
+        results.Merge(tallies[t]);
+    return true;
+}
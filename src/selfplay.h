@@ -0,0 +1,80 @@
+#ifndef HOLDEM_SELFPLAY_H
+#define HOLDEM_SELFPLAY_H
+
+#include "combo.h"
+#include <stdint.h>
+
+#define MAX_SELFPLAY_PLAYERS 10
+
+/// Represents what an agent does preflop with a class of hole cards.
+enum PreflopAction
+{
+    Action_Fold = 0,
+    Action_Call = 1,	/* limp, complete, check or call a raise */
+    Action_Raise = 2	/* open for a raise; calls if already raised */
+};
+
+/**
+ * Represents a preflop strategy as two tables over the classes of hole
+ * cards (see combo.h): the action when nobody has raised yet, and the
+ * action when facing a raise. There is a single raise per hand, so a
+ * raise facing a raise counts as a call.
+ */
+struct PreflopStrategy
+{
+    uint8_t open[NUM_HOLE_CLASSES];			/* PreflopAction, unraised */
+    uint8_t versus_raise[NUM_HOLE_CLASSES];	/* PreflopAction, raised */
+};
+
+/**
+ * Returns a strategy that raises with the best open_fraction of the hole
+ * card combinations, folds the others when unraised (the big blind
+ * checks), and calls a raise with the best call_fraction. The classes are
+ * ranked by their equity against one random hand.
+ */
+PreflopStrategy MakeThresholdStrategy(double open_fraction, double call_fraction);
+
+/// Describes a table of agents playing against each other.
+struct SelfPlayConfig
+{
+    int num_players;					/* 2 to MAX_SELFPLAY_PLAYERS */
+    double small_blind;					/* in big blinds, e.g. 0.5 */
+    double raise_size;					/* total bet of a raise in big blinds */
+    const PreflopStrategy *strategies;	/* one per agent */
+};
+
+/**
+ * Represents the results of self-play, in big blinds. Positions are
+ * numbered from the small blind: 0 is the small blind, 1 the big blind,
+ * 2 the first to act preflop, and num_players - 1 the button (which is
+ * also the small blind heads-up).
+ */
+struct SelfPlayResults
+{
+    int64_t num_hands;
+    int64_t num_showdowns;
+    int64_t agent_hands[MAX_SELFPLAY_PLAYERS][MAX_SELFPLAY_PLAYERS];	/* [agent][position] */
+    double agent_net[MAX_SELFPLAY_PLAYERS][MAX_SELFPLAY_PLAYERS];
+    int64_t class_hands[MAX_SELFPLAY_PLAYERS][NUM_HOLE_CLASSES];	/* [position][class] */
+    double class_net[MAX_SELFPLAY_PLAYERS][NUM_HOLE_CLASSES];
+
+    SelfPlayResults() { Clear(); }
+
+    void Clear();
+    void Merge(const SelfPlayResults &a);
+};
+
+/**
+ * Plays num_hands hands of hold'em between the agents. The button moves
+ * after every hand, so each agent plays each position in turn. The
+ * agents act preflop as their strategies dictate, and the players left
+ * after the preflop betting check the hand down to a showdown.
+ *
+ * The hands are dealt in batches of eight by a LaneDealer on each thread,
+ * and the showdowns of a batch are evaluated together with EvaluateHands.
+ * Returns false if the configuration is invalid.
+ */
+bool SimulateSelfPlay(const SelfPlayConfig &config, int64_t num_hands,
+                      uint64_t seed, SelfPlayResults &results);
+
+#endif /* HOLDEM_SELFPLAY_H */
@@ -0,0 +1,418 @@
+#include "server.h"
+#include "board.h"
+#include "deck.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/// Number of runouts settled between two suspensions of a query, i.e.
+/// the longest a waiting query can be held up (about 100 microseconds).
+#define QUERY_CHUNK_SIZE 1024
+
+const char* GetQueryStatusName(QueryStatus status)
+{
+    static const char *names[] = { "done", "timeout", "cancelled", "invalid" };
+    return names[status];
+}
+
+/// Returns the table of C(n, k) for n <= 52 and k <= 5.
+static const int64_t (&GetBinomialTable())[53][6]
+{
+    static const struct Table
+    {
+        int64_t c[53][6];
+    } table = []()
+    {
+        Table t;
+        for (int n = 0; n <= 52; n++)
+        {
+            t.c[n][0] = 1;
+            for (int k = 1; k <= 5; k++)
+                t.c[n][k] = (n == 0)? 0 : t.c[n - 1][k - 1] + t.c[n - 1][k];
+        }
+        return t;
+    }();
+    return table.c;
+}
+
+/**
+ * Stores in indices the k-combination of {0, ..., n-1} with the given rank
+ * in colexicographic order, i.e. rank = C(indices[0], 1) + ... +
+ * C(indices[k-1], k). Takes at most n steps in all.
+ */
+static void UnrankCombination(int64_t rank, int n, int k, int *indices)
+{
+    const int64_t (&choose)[53][6] = GetBinomialTable();
+    int c = n;
+    for (int i = k; i > 0; i--)
+    {
+        do
+            --c;
+        while (choose[c][i] > rank);
+        indices[i - 1] = c;
+        rank -= choose[c][i];
+    }
+}
+
+static int64_t GreatestCommonDivisor(int64_t a, int64_t b)
+{
+    while (b != 0)
+    {
+        int64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+QueryTask SettleQuery(EquityQuery query, QueryResponse &response,
+                      const std::atomic<bool> &cancelled)
+{
+    typedef std::chrono::steady_clock clock;
+
+    int n = query.num_players;
+    response.id = query.id;
+    response.status = Query_Invalid;
+    response.num_players = n;
+    response.num_deals = 0;
+    response.num_runouts = 0;
+    for (int i = 0; i < MAX_EQUITY_PLAYERS; i++)
+        response.equity[i] = response.std_error[i] = 0;
+
+    // Check the cards as ComputeEquityByDeadline does.
+    int num_board = query.board.GetCardCount();
+    if (n < 2 || n > MAX_EQUITY_PLAYERS || num_board > 5 ||
+        (query.board.GetCardSet() & query.dead) != 0)
+        co_return;
+    CardSet known = query.dead | query.board.GetCardSet();
+    for (int i = 0; i < n; i++)
+    {
+        if (query.holes[i].GetCardCount() != 2 ||
+            (known & query.holes[i].GetCardSet()) != 0)
+            co_return;
+        known |= query.holes[i].GetCardSet();
+    }
+    Deck deck(known);
+    int need = 5 - num_board;
+    if (need > deck.num_cards)
+        co_return;
+
+    // Visit the runout of rank (i * stride + offset) mod total at step i,
+    // which is a permutation of the ranks when the stride is coprime to
+    // the total.
+    int64_t total = GetBinomialTable()[deck.num_cards][need];
+    int64_t stride = (int64_t)(0x9E3779B97F4A7C15ULL % (uint64_t)total);
+    while (GreatestCommonDivisor(stride, total) != 1)
+        ++stride;
+    int64_t offset = (int64_t)((uint64_t)query.id * 0xBF58476D1CE4E5B9ULL % (uint64_t)total);
+    response.num_runouts = total;
+    response.status = Query_Done;
+
+    double sum[MAX_EQUITY_PLAYERS] = { 0 };
+    double sum_squares[MAX_EQUITY_PLAYERS] = { 0 };
+    int64_t done = 0;
+    while (done < total)
+    {
+        if (cancelled.load(std::memory_order_relaxed))
+        {
+            response.status = Query_Cancelled;
+            break;
+        }
+        if (clock::now() >= query.deadline)
+        {
+            response.status = Query_Timeout;
+            break;
+        }
+
+        int64_t end = std::min(done + QUERY_CHUNK_SIZE, total);
+        for (; done < end; done++)
+        {
+            int index[5];
+            UnrankCombination((done * stride + offset) % total, deck.num_cards,
+                              need, index);
+            Hand board = query.board;
+            for (int i = 0; i < need; i++)
+                board += deck.cards[index[i]];
+
+            BoardContext context(board);
+            uint32_t winners = ResolveShowdown(context, query.holes, n, NULL);
+            double share = 1.0 / intrinsic::pop_count(winners);
+            for (int i = 0; i < n; i++)
+            {
+                if ((winners >> i) & 1)
+                {
+                    sum[i] += share;
+                    sum_squares[i] += share * share;
+                }
+            }
+        }
+        if (done < total)
+            co_await std::suspend_always();
+    }
+
+    // Sampling without replacement shrinks the variance by the finite
+    // population correction.
+    double d = (double)done;
+    double correction = (total > 1)? (double)(total - done) / (total - 1) : 0.0;
+    for (int i = 0; i < n && done > 0; i++)
+    {
+        double mean = sum[i] / d;
+        double variance = (done > 1)?
+            std::max(sum_squares[i] - d * mean * mean, 0.0) / (d - 1) : 0.0;
+        response.equity[i] = mean;
+        response.std_error[i] = std::sqrt(variance / d * correction);
+    }
+    response.num_deals = done;
+}
+
+/// Parses cards such as "AsKs" into one Hand per card. Returns the number
+/// of cards, or -1 if the text is not a list of distinct cards.
+static int ParseCards(const std::string &s, Hand cards[52])
+{
+    static const char ranks[] = "23456789TJQKA";
+    static const char suits[] = "cdhs";
+    if (s.size() % 2 != 0 || s.size() > 104)
+        return -1;
+    CardSet seen = 0;
+    int n = 0;
+    for (size_t i = 0; i < s.size(); i += 2)
+    {
+        const char *r = strchr(ranks, s[i]);
+        const char *u = strchr(suits, s[i + 1]);
+        if (r == NULL || u == NULL)
+            return -1;
+        cards[n] = Hand(Card((Rank)(r - ranks), (Suit)(u - suits)));
+        if (seen & cards[n].GetCardSet())
+            return -1;
+        seen |= cards[n++].GetCardSet();
+    }
+    return n;
+}
+
+bool ParseEquityQuery(const char *text, EquityQuery &query)
+{
+    std::istringstream in(text);
+    int64_t milliseconds;
+    if (!(in >> query.id >> milliseconds))
+        return false;
+    query.deadline = std::chrono::steady_clock::now() +
+                     std::chrono::milliseconds(milliseconds);
+    query.num_players = 0;
+    query.board = Hand();
+    query.dead = 0;
+
+    // The hole cards come first, then the board and dead cards by keyword.
+    std::string token;
+    bool holes_done = false;
+    Hand cards[52];
+    while (in >> token)
+    {
+        if (token == "board" || token == "dead")
+        {
+            holes_done = true;
+            bool board = (token == "board");
+            int n = (in >> token)? ParseCards(token, cards) : -1;
+            if (n < 0 || (board && query.board.GetCardCount() + n > 5))
+                return false;
+            for (int i = 0; i < n; i++)
+            {
+                if (board)
+                    query.board += cards[i];
+                else
+                    query.dead |= cards[i].GetCardSet();
+            }
+        }
+        else
+        {
+            if (holes_done || query.num_players >= MAX_EQUITY_PLAYERS ||
+                ParseCards(token, cards) != 2)
+                return false;
+            query.holes[query.num_players++] = cards[0] + cards[1];
+        }
+    }
+    return query.num_players > 0;
+}
+
+/// Represents one event loop: a thread and the queries it runs.
+struct QueryServer::EventLoop
+{
+    /// Represents a query in flight.
+    struct Flight
+    {
+        QueryResponse response;
+        std::atomic<bool> cancelled;
+        QueryTask task;
+        std::chrono::steady_clock::time_point deadline;
+        int64_t num_chunks;		/* number of times it has run */
+        int64_t turn;			/* when it last ran */
+    };
+
+    /// Orders the flights by the number of chunks run, then by deadline,
+    /// then by turn, the first to run last.
+    struct Later
+    {
+        bool operator()(const Flight *a, const Flight *b) const
+        {
+            if (a->num_chunks != b->num_chunks)
+                return a->num_chunks > b->num_chunks;
+            if (a->deadline != b->deadline)
+                return a->deadline > b->deadline;
+            return a->turn > b->turn;
+        }
+    };
+
+    std::mutex mutex;					/* guards the fields below */
+    std::condition_variable wake;		/* signals mail or stop */
+    std::condition_variable idle;		/* signals that all have answered */
+    std::vector<EquityQuery> inbox;		/* queries not yet started */
+    std::vector<int64_t> cancels;		/* ids to cancel */
+    int64_t num_pending;				/* queries submitted, not answered */
+    bool stop;
+    std::atomic<bool> has_mail;			/* inbox or cancels not empty */
+    std::thread thread;
+
+    EventLoop() : num_pending(0), stop(false), has_mail(false) { }
+
+    void Run(const Callback &callback)
+    {
+        std::priority_queue<Flight*, std::vector<Flight*>, Later> ready;
+        std::unordered_multimap<int64_t, std::unique_ptr<Flight>> flights;
+        int64_t turn = 0;
+
+        for (;;)
+        {
+            // Take the mail between two chunks, or wait for it when there
+            // is nothing to run.
+            if (has_mail.load(std::memory_order_acquire) || ready.empty())
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]()
+                {
+                    return stop || !inbox.empty() || !cancels.empty() || !ready.empty();
+                });
+                for (size_t i = 0; i < inbox.size(); i++)
+                {
+                    std::unique_ptr<Flight> flight(new Flight);
+                    flight->cancelled = false;
+                    flight->deadline = inbox[i].deadline;
+                    flight->num_chunks = 0;
+                    flight->turn = turn++;
+                    flight->task = SettleQuery(inbox[i], flight->response,
+                                               flight->cancelled);
+                    ready.push(flight.get());
+                    flights.emplace(inbox[i].id, std::move(flight));
+                }
+                inbox.clear();
+                for (size_t i = 0; i < cancels.size(); i++)
+                {
+                    auto range = flights.equal_range(cancels[i]);
+                    for (auto it = range.first; it != range.second; ++it)
+                        it->second->cancelled = true;
+                }
+                cancels.clear();
+                has_mail = false;
+
+                // On stop, cancel everything and answer before leaving.
+                if (stop)
+                {
+                    if (ready.empty())
+                        break;
+                    for (auto it = flights.begin(); it != flights.end(); ++it)
+                        it->second->cancelled = true;
+                }
+                if (ready.empty())
+                    continue;
+            }
+
+            Flight *flight = ready.top();
+            ready.pop();
+            if (!flight->task.Resume())
+            {
+                flight->num_chunks++;
+                flight->turn = turn++;
+                ready.push(flight);
+                continue;
+            }
+
+            callback(flight->response);
+            auto range = flights.equal_range(flight->response.id);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second.get() == flight)
+                {
+                    flights.erase(it);
+                    break;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--num_pending == 0)
+                idle.notify_all();
+        }
+    }
+};
+
+QueryServer::QueryServer(int num_loops, Callback callback)
+    : callback_(callback)
+{
+    for (int i = 0; i < std::max(num_loops, 1); i++)
+    {
+        loops_.push_back(std::unique_ptr<EventLoop>(new EventLoop));
+        EventLoop *loop = loops_.back().get();
+        loop->thread = std::thread([this, loop]() { loop->Run(callback_); });
+    }
+}
+
+QueryServer::~QueryServer()
+{
+    for (size_t i = 0; i < loops_.size(); i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(loops_[i]->mutex);
+            loops_[i]->stop = true;
+            loops_[i]->has_mail = true;
+        }
+        loops_[i]->wake.notify_one();
+    }
+    for (size_t i = 0; i < loops_.size(); i++)
+        loops_[i]->thread.join();
+}
+
+void QueryServer::Submit(const EquityQuery &query)
+{
+    EventLoop &loop = *loops_[(uint64_t)query.id % loops_.size()];
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        loop.inbox.push_back(query);
+        ++loop.num_pending;
+        loop.has_mail = true;
+    }
+    loop.wake.notify_one();
+}
+
+void QueryServer::Cancel(int64_t id)
+{
+    EventLoop &loop = *loops_[(uint64_t)id % loops_.size()];
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        loop.cancels.push_back(id);
+        loop.has_mail = true;
+    }
+    loop.wake.notify_one();
+}
+
+void QueryServer::Drain()
+{
+    for (size_t i = 0; i < loops_.size(); i++)
+    {
+        std::unique_lock<std::mutex> lock(loops_[i]->mutex);
+        loops_[i]->idle.wait(lock, [&]() { return loops_[i]->num_pending == 0; });
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef HOLDEM_SERVER_H
+#define HOLDEM_SERVER_H
+
+#include "equity.h"
+#include "hand.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// Represents a request for the equity of known hole cards.
+struct EquityQuery
+{
+    int64_t id;								/* chosen by the client */
+    Hand holes[MAX_EQUITY_PLAYERS];			/* hole cards of each player */
+    int num_players;
+    Hand board;								/* zero to five known cards */
+    CardSet dead;							/* cards known to be out of play */
+    std::chrono::steady_clock::time_point deadline;
+};
+
+enum QueryStatus
+{
+    Query_Done,			/* every runout was settled */
+    Query_Timeout,		/* the deadline passed; the equity is an estimate */
+    Query_Cancelled,	/* cancelled before it finished */
+    Query_Invalid		/* the cards are invalid */
+};
+
+/// Returns a short name such as "done" or "timeout".
+const char* GetQueryStatusName(QueryStatus status);
+
+/// Represents the answer to an EquityQuery.
+struct QueryResponse
+{
+    int64_t id;
+    QueryStatus status;
+    int num_players;
+    double equity[MAX_EQUITY_PLAYERS];		/* share of the pot of each player */
+    double std_error[MAX_EQUITY_PLAYERS];	/* zero if every runout was settled */
+    int64_t num_deals;						/* number of runouts settled */
+    int64_t num_runouts;					/* number of distinct runouts */
+};
+
+/**
+ * The coroutine that settles one query. It settles the runouts one chunk
+ * at a time and suspends after each chunk, so that the event loop that
+ * owns it can run other queries in between, and it checks its deadline
+ * and cancellation flag before each chunk.
+ */
+class QueryTask
+{
+public:
+    struct promise_type
+    {
+        QueryTask get_return_object()
+        {
+            return QueryTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { throw; }
+    };
+
+    QueryTask() { }
+    QueryTask(QueryTask &&a) noexcept : handle_(a.handle_) { a.handle_ = nullptr; }
+    QueryTask& operator=(QueryTask &&a) noexcept
+    {
+        std::swap(handle_, a.handle_);
+        return *this;
+    }
+    ~QueryTask()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    /// Runs the query up to its next chunk. Returns true when it is done.
+    bool Resume()
+    {
+        handle_.resume();
+        return handle_.done();
+    }
+
+private:
+    explicit QueryTask(std::coroutine_handle<promise_type> handle) : handle_(handle) { }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * Creates the coroutine for a query; nothing runs until it is resumed.
+ * The runouts are visited in a scrambled order, so that the runouts
+ * settled when the deadline passes are a random sample of them. The
+ * query is copied into the coroutine; the response and the flag must
+ * outlive the task.
+ */
+QueryTask SettleQuery(EquityQuery query, QueryResponse &response,
+                      const std::atomic<bool> &cancelled);
+
+/**
+ * Parses a query in the text protocol of the server mode:
+ *   <id> <deadline in ms> <hole cards>... [board <cards>] [dead <cards>]
+ * e.g. "1 50 AsKs QdQc board Qs7s2h", the deadline counting from now.
+ * Returns false if the text is malformed.
+ */
+bool ParseEquityQuery(const char *text, EquityQuery &query);
+
+/**
+ * Answers equity queries on a set of event loops, each a thread running
+ * many queries as coroutines.
+ *
+ * A loop runs one chunk of runouts of one query at a time, always from
+ * the query that has run the fewest chunks, then the one with the earliest
+ * deadline. A query submitted behind long exhaustive ones thus starts
+ * within one chunk, and a short query is done before the long ones have
+ * run much longer; the long ones share the rest of the time evenly.
+ * Queries past their deadline answer with the runouts settled so far.
+ *
+ * The responses are passed to the callback on the thread of the loop.
+ */
+class QueryServer
+{
+public:
+    typedef std::function<void(const QueryResponse&)> Callback;
+
+    QueryServer(int num_loops, Callback callback);
+
+    /// Cancels the queries in flight and stops the loops.
+    ~QueryServer();
+
+    /// Queues a query on the loop chosen by its id.
+    void Submit(const EquityQuery &query);
+
+    /// Cancels a query if it is still in flight; it then answers with
+    /// Query_Cancelled. Unknown ids are ignored.
+    void Cancel(int64_t id);
+
+    /// Waits until every query submitted so far has answered.
+    void Drain();
+
+private:
+    struct EventLoop;
+
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    Callback callback_;
+
+    QueryServer(const QueryServer&);
+    QueryServer& operator=(const QueryServer&);
+};
+
+#endif /* HOLDEM_SERVER_H */
@@ -0,0 +1,238 @@
+#include "shuffle.h"
+#include "arena.h"
+#include "combo.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++)
+    {
+        uint64_t p0 = (uint64_t)0xD2511F53U * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57U * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9U;
+        k1 += 0xBB67AE85U;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+bool VerifyPhilox()
+{
+    static const uint32_t vectors[3][10] = {
+        // counter, key, expected output
+        { 0, 0, 0, 0, 0, 0,
+          0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8 },
+        { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+          0x408F276D, 0x41C83B0E, 0xA20BC7C6, 0x6D5451FD },
+        { 0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344, 0xA4093822, 0x299F31D0,
+          0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1 },
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t out[4];
+        Philox4x32(&vectors[i][0], &vectors[i][4], out);
+        if (!std::equal(out, out + 4, &vectors[i][6]))
+            return false;
+    }
+    return true;
+}
+
+void DealGenerator::Deal(uint64_t deal, int num_cards, uint8_t *cards) const
+{
+    uint8_t deck[52];
+    for (int i = 0; i < 52; i++)
+        deck[i] = (uint8_t)i;
+
+    // Each draw takes 16 random bits, the halves of the words of the
+    // Philox blocks in order, so a full deck takes seven blocks.
+    uint32_t counter[4] = { (uint32_t)deal, (uint32_t)(deal >> 32), 0, 0 };
+    uint32_t words[4];
+    int next = 8;
+    auto draw = [&]() -> uint32_t
+    {
+        if (next == 8)
+        {
+            Philox4x32(counter, key_, words);
+            ++counter[2];
+            next = 0;
+        }
+        uint32_t w = words[next >> 1] >> (16 * (next & 1));
+        ++next;
+        return w & 0xFFFF;
+    };
+
+    for (int i = 0; i < num_cards; i++)
+    {
+        // Draw a position in [i, 52) by Lemire's method: the high half of
+        // 16 random bits times the range, rejecting the few low halves that
+        // would make some positions more likely than others. The threshold
+        // takes a division, which is only needed when the low half is small.
+        uint32_t range = 52 - i;
+        uint32_t m = draw() * range;
+        if ((m & 0xFFFF) < range)
+        {
+            uint32_t threshold = (0x10000 - range) % range;
+            while ((m & 0xFFFF) < threshold)
+                m = draw() * range;
+        }
+
+        int j = i + (int)(m >> 16);
+        std::swap(deck[i], deck[j]);
+        cards[i] = deck[i];
+    }
+}
+
+/// Number of deals generated per chunk by WriteDeals.
+#define DEAL_CHUNK_SIZE 65536
+
+bool WriteDeals(FILE *file, const DealGenerator &generator, uint64_t first_deal,
+                int64_t num_deals, int cards_per_deal, int num_threads)
+{
+    if (cards_per_deal < 1 || cards_per_deal > 52 || num_deals < 0)
+        return false;
+
+    // Generate one chunk while the writer thread writes the one before.
+    size_t chunk_bytes = (size_t)DEAL_CHUNK_SIZE * cards_per_deal;
+    std::vector<uint8_t> buffers[2] = {
+        std::vector<uint8_t>(chunk_bytes), std::vector<uint8_t>(chunk_bytes)
+    };
+    std::thread writer;
+    bool ok = true;
+    int b = 0;
+    for (int64_t begin = 0; begin < num_deals; begin += DEAL_CHUNK_SIZE, b ^= 1)
+    {
+        int64_t count = std::min<int64_t>(DEAL_CHUNK_SIZE, num_deals - begin);
+        uint8_t *data = &buffers[b][0];
+        ParallelFor(count, num_threads, [&](int, int64_t first, int64_t last)
+        {
+            for (int64_t i = first; i < last; i++)
+                generator.Deal(first_deal + begin + i, cards_per_deal, data + i * cards_per_deal);
+        });
+
+        if (writer.joinable())
+            writer.join();
+        size_t size = (size_t)count * cards_per_deal;
+        writer = std::thread([&ok, file, data, size]()
+        {
+            if (fwrite(data, 1, size, file) != size)
+                ok = false;
+        });
+    }
+    if (writer.joinable())
+        writer.join();
+    return ok && fflush(file) == 0;
+}
+
+/// Returns the chance that a chi-square variable with the given degrees of
+/// freedom exceeds x, by the Wilson-Hilferty approximation.
+static double GetChiSquarePValue(double x, int degrees_of_freedom)
+{
+    double k = degrees_of_freedom;
+    double z = (std::cbrt(x / k) - (1 - 2 / (9 * k))) / std::sqrt(2 / (9 * k));
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+/// Holds the counts of one thread of RunDealTests.
+struct DealTestCounts
+{
+    int64_t position[52][52];		/* [position][card] */
+    int64_t pairs[52][52];			/* [first card][second card] */
+    int64_t classes[NUM_HOLE_CLASSES];
+};
+
+void RunDealTests(const DealGenerator &generator, uint64_t first_deal,
+                  int64_t num_deals, int num_threads,
+                  DealTestResult results[NUM_DEAL_TESTS])
+{
+    ArenaScope scope;
+    DealTestCounts *counts = scope.New<DealTestCounts>(num_threads);
+    memset(counts, 0, sizeof(DealTestCounts) * num_threads);
+    ParallelFor(num_deals, num_threads, [&](int thread, int64_t begin, int64_t end)
+    {
+        DealTestCounts &c = counts[thread];
+        uint8_t cards[52];
+        for (int64_t i = begin; i < end; i++)
+        {
+            uint64_t deal = first_deal + i;
+            generator.Deal(deal, 52, cards);
+            for (int p = 0; p < 52; p++)
+                c.position[p][cards[p]]++;
+            int p = (int)(deal % 51);
+            c.pairs[cards[p]][cards[p + 1]]++;
+            c.classes[GetHoleClass(GetCardHand(cards[0]) + GetCardHand(cards[1]))]++;
+        }
+    });
+    for (int t = 1; t < num_threads; t++)
+    {
+        for (int i = 0; i < 52; i++)
+        {
+            for (int j = 0; j < 52; j++)
+            {
+                counts[0].position[i][j] += counts[t].position[i][j];
+                counts[0].pairs[i][j] += counts[t].pairs[i][j];
+            }
+        }
+        for (int i = 0; i < NUM_HOLE_CLASSES; i++)
+            counts[0].classes[i] += counts[t].classes[i];
+    }
+    const DealTestCounts &c = counts[0];
+    double n = (double)num_deals;
+
+    // Each shuffle places every card once, which removes 2 * 51 + 1
+    // degrees of freedom and scales the statistic by 52 / 51.
+    double chi_square = 0;
+    for (int i = 0; i < 52; i++)
+    {
+        for (int j = 0; j < 52; j++)
+        {
+            double d = c.position[i][j] - n / 52;
+            chi_square += d * d / (n / 52);
+        }
+    }
+    results[0].name = "position";
+    results[0].chi_square = chi_square * 51 / 52;
+    results[0].degrees_of_freedom = 51 * 51;
+
+    chi_square = 0;
+    for (int i = 0; i < 52; i++)
+    {
+        for (int j = 0; j < 52; j++)
+        {
+            if (i == j)
+                continue;
+            double d = c.pairs[i][j] - n / (52 * 51);
+            chi_square += d * d / (n / (52 * 51));
+        }
+    }
+    results[1].name = "pairs";
+    results[1].chi_square = chi_square;
+    results[1].degrees_of_freedom = 52 * 51 - 1;
+
+    chi_square = 0;
+    for (int i = 0; i < NUM_HOLE_CLASSES; i++)
+    {
+        const uint16_t *combos;
+        double e = n * GetClassCombos(i, &combos) / NUM_COMBOS;
+        double d = c.classes[i] - e;
+        chi_square += d * d / e;
+    }
+    results[2].name = "hole class";
+    results[2].chi_square = chi_square;
+    results[2].degrees_of_freedom = NUM_HOLE_CLASSES - 1;
+
+    for (int i = 0; i < NUM_DEAL_TESTS; i++)
+        results[i].p_value = GetChiSquarePValue(results[i].chi_square, results[i].degrees_of_freedom);
+}
@@ -0,0 +1,95 @@
+#ifndef HOLDEM_SHUFFLE_H
+#define HOLDEM_SHUFFLE_H
+
+#include "hand.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Computes one block of the Philox4x32-10 counter-based generator of
+ * Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3" (SC 2011):
+ * ten rounds of multiplications and XORs that map a 128-bit counter and a
+ * 64-bit key to four 32-bit random words. Any block can be computed on its
+ * own, so there is no state to share or to skip ahead.
+ */
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+/// Checks Philox4x32 against the known-answer vectors of the reference
+/// implementation (Random123). Returns false on any mismatch.
+bool VerifyPhilox();
+
+/**
+ * Generates shuffled decks that can be audited. Shuffle number n of a seed
+ * is a Fisher-Yates shuffle driven by the Philox blocks with the counter
+ * (n, block) and the seed as the key, and nothing else: given the seed,
+ * anyone can reproduce any deal from its number alone, and deals can be
+ * generated on any number of threads in any order with the same result.
+ *
+ * The positions are drawn from 16 random bits each by Lemire's
+ * multiply-shift method with rejection, so every permutation is exactly
+ * equally likely, and a full deck takes seven Philox blocks.
+ *
+ * A card is numbered suit * 13 + rank, as in combo.h.
+ */
+class DealGenerator
+{
+public:
+    explicit DealGenerator(uint64_t seed)
+    {
+        key_[0] = (uint32_t)seed;
+        key_[1] = (uint32_t)(seed >> 32);
+    }
+
+    /// Stores the first num_cards cards of shuffle number deal.
+    void Deal(uint64_t deal, int num_cards, uint8_t *cards) const;
+
+private:
+    uint32_t key_[2];
+};
+
+/// Returns the Hand holding a card numbered suit * 13 + rank.
+inline Hand GetCardHand(int card)
+{
+    return Hand(Card((Rank)(card % 13), (Suit)(card / 13)));
+}
+
+/**
+ * Writes num_deals deals of cards_per_deal cards each, starting from shuffle
+ * number first_deal, to a binary file: one byte per card, the deals one
+ * after another. The deals are generated in chunks on num_threads threads
+ * while the previous chunk is written, so the file is the same for any
+ * number of threads. Returns false if the file cannot be written.
+ */
+bool WriteDeals(FILE *file, const DealGenerator &generator, uint64_t first_deal,
+                int64_t num_deals, int cards_per_deal, int num_threads);
+
+/// Represents the result of a chi-square test.
+struct DealTestResult
+{
+    const char *name;
+    double chi_square;
+    int degrees_of_freedom;
+    double p_value;				/* chance of a larger chi-square */
+};
+
+#define NUM_DEAL_TESTS 3
+
+/**
+ * Runs a battery of chi-square tests on num_deals full shuffles:
+ *
+ *   - "position": how often each card lands in each position;
+ *   - "pairs": how often each ordered pair of cards lands in two adjacent
+ *     positions, the pair of positions moving along the deck from one
+ *     shuffle to the next so that each shuffle adds one observation;
+ *   - "hole class": the class of the first two cards (see combo.h),
+ *     against the exact frequencies 6, 4 and 12 in 1326.
+ *
+ * The p-values come from the Wilson-Hilferty approximation, which is close
+ * for these degrees of freedom. A sound generator gives p-values spread
+ * evenly over [0, 1]; a p-value very close to 0 or 1 suggests a bias.
+ */
+void RunDealTests(const DealGenerator &generator, uint64_t first_deal,
+                  int64_t num_deals, int num_threads,
+                  DealTestResult results[NUM_DEAL_TESTS]);
+
+#endif /* HOLDEM_SHUFFLE_H */
@@ -0,0 +1,135 @@
+#include "strength_index.h"
+#include "arena.h"
+#include "board.h"
+#include "deck.h"
+#include <algorithm>
+#include <cassert>
+
+/**
+ * Sorts the keys in ascending order by a least-significant-digit radix
+ * sort on the low 30 bits, in three passes of 10 bits. The permutation is
+ * applied to the payload alongside the keys.
+ */
+static void RadixSort(uint32_t *keys, uint16_t *payload, size_t n)
+{
+    ArenaScope scope;
+    uint32_t *keys2 = scope.New<uint32_t>(n);
+    uint16_t *payload2 = scope.New<uint16_t>(n);
+    uint32_t *keys_out = keys;
+    uint16_t *payload_out = payload;
+    for (int shift = 0; shift < 30; shift += 10)
+    {
+        size_t count[1025] = { 0 };
+        for (size_t i = 0; i < n; i++)
+            ++count[((keys[i] >> shift) & 1023) + 1];
+        for (int d = 0; d < 1024; d++)
+            count[d + 1] += count[d];
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t k = count[(keys[i] >> shift) & 1023]++;
+            keys2[k] = keys[i];
+            payload2[k] = payload[i];
+        }
+        std::swap(keys, keys2);
+        std::swap(payload, payload2);
+    }
+
+    // The odd number of passes leaves the result in the scratch arrays.
+    std::copy(keys, keys + n, keys_out);
+    std::copy(payload, payload + n, payload_out);
+}
+
+BoardStrengthIndex::BoardStrengthIndex(const Hand &board, CardSet dead)
+{
+    int num_board = board.GetCardCount();
+    assert(num_board >= 3 && num_board <= 5);
+
+    // List the live combinations and evaluate them in one batch. On the
+    // river every combination shares the board context.
+    ArenaScope scope;
+    Deck deck(dead | board.GetCardSet());
+    size_t n = deck.num_cards * (deck.num_cards - 1) / 2;
+    Hand *combos = scope.New<Hand>(n);
+    size_t num_listed = 0;
+    ForEachCombination(deck.num_cards, 2, [&](const int *index)
+    {
+        combos[num_listed++] = deck.cards[index[0]] + deck.cards[index[1]];
+    });
+
+    HandStrength *strengths = scope.New<HandStrength>(n);
+    if (num_board == 5)
+    {
+        BoardContext context(board);
+        for (size_t i = 0; i < n; i++)
+            strengths[i] = context.Evaluate(combos[i]);
+    }
+    else
+    {
+        Hand *hands = scope.New<Hand>(n);
+        for (size_t i = 0; i < n; i++)
+            hands[i] = board + combos[i];
+        EvaluateHands(hands, strengths, n);
+    }
+
+    // Sort by complemented strength so that the strongest comes first.
+    uint32_t *keys = scope.New<uint32_t>(n);
+    uint16_t *order = scope.New<uint16_t>(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i] = ~strengths[i].value & 0x3FFFFFFF;
+        order[i] = (uint16_t)i;
+    }
+    RadixSort(keys, order, n);
+
+    num_combos_ = (int)n;
+    for (size_t i = 0; i < n; i++)
+    {
+        holes_[i] = combos[order[i]];
+        strengths_[i] = strengths[order[i]];
+    }
+
+    // Record the range of equal strengths for each combination.
+    Slot dead_slot = { 0, 0 };
+    std::fill(slots_, slots_ + NUM_COMBOS, dead_slot);
+    for (size_t i = 0; i < n; )
+    {
+        size_t j = i;
+        while (j < n && strengths_[j] == strengths_[i])
+            ++j;
+        for (size_t k = i; k < j; k++)
+        {
+            Slot &slot = slots_[GetSlot(holes_[k])];
+            slot.begin = (uint16_t)i;
+            slot.end = (uint16_t)j;
+        }
+        i = j;
+    }
+}
+
+int BoardStrengthIndex::CountStronger(HandStrength strength) const
+{
+    // The strengths are sorted in descending order.
+    return (int)(std::lower_bound(strengths_, strengths_ + num_combos_, strength,
+        [](const HandStrength &a, const HandStrength &b) { return a > b; })
+        - strengths_);
+}
+
+int BoardStrengthIndex::CountTied(HandStrength strength) const
+{
+    auto range = std::equal_range(strengths_, strengths_ + num_combos_, strength,
+        [](const HandStrength &a, const HandStrength &b) { return a > b; });
+    return (int)(range.second - range.first);
+}
+
+int BoardStrengthIndex::GetTopHands(int k, Hand *holes, HandStrength *strengths) const
+{
+    k = std::min(k, GetComboCount());
+    for (int i = 0; i < k; i++)
+    {
+        if (holes)
+            holes[i] = holes_[i];
+        if (strengths)
+            strengths[i] = strengths_[i];
+    }
+    return k;
+}
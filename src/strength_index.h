@@ -0,0 +1,108 @@
+#ifndef HOLDEM_STRENGTH_INDEX_H
+#define HOLDEM_STRENGTH_INDEX_H
+
+#include "combo.h"
+#include "hand.h"
+
+/// Number of pairs of hole cards that are live on a flop without dead cards.
+#define MAX_BOARD_COMBOS 1176
+
+/**
+ * Ranks every live pair of hole cards on a board by the strength of the
+ * resulting hand, and answers queries such as the percentile of a hand,
+ * how many hands beat or tie it, and which hands are the nuts.
+ *
+ * All live combinations (1,081 on the river without dead cards) are
+ * evaluated in one batch when the index is built, and radix-sorted by
+ * strength, strongest first. Each combination then knows the range of
+ * sorted positions that hold its strength, so the queries by hole cards
+ * take O(1); queries by strength binary-search the sorted strengths.
+ * The index is held in fixed arrays and built with scratch memory from
+ * the thread's arena, so building one makes no heap allocation.
+ *
+ * The counts are over all live combinations on the board; they do not
+ * remove the combinations that share a card with the queried hand.
+ */
+class BoardStrengthIndex
+{
+public:
+    /// Builds the index for a board of three to five cards, excluding
+    /// the hole cards that hold a dead card.
+    explicit BoardStrengthIndex(const Hand &board, CardSet dead = 0);
+
+    /// Returns the number of live combinations on the board.
+    int GetComboCount() const { return num_combos_; }
+
+    /// Returns true if the given hole cards are a live combination.
+    bool Contains(const Hand &hole) const
+    {
+        return slots_[GetSlot(hole)].end != 0;
+    }
+
+    /// Returns the number of combinations stronger than the given live
+    /// hole cards.
+    int CountStronger(const Hand &hole) const
+    {
+        return slots_[GetSlot(hole)].begin;
+    }
+
+    /// Returns the number of other combinations that tie the given live
+    /// hole cards.
+    int CountTied(const Hand &hole) const
+    {
+        const Slot &slot = slots_[GetSlot(hole)];
+        return slot.end - slot.begin - 1;
+    }
+
+    /// Returns the number of combinations weaker than the given live hole
+    /// cards.
+    int CountWeaker(const Hand &hole) const
+    {
+        return GetComboCount() - slots_[GetSlot(hole)].end;
+    }
+
+    /// Returns the fraction of the other combinations that the given live
+    /// hole cards beat, counting a tie as half.
+    double GetPercentile(const Hand &hole) const
+    {
+        if (GetComboCount() <= 1)
+            return 1.0;
+        return (CountWeaker(hole) + 0.5 * CountTied(hole)) /
+            (GetComboCount() - 1);
+    }
+
+    /// Returns the number of combinations stronger than a given strength.
+    int CountStronger(HandStrength strength) const;
+
+    /// Returns the number of combinations equal to a given strength.
+    int CountTied(HandStrength strength) const;
+
+    /**
+     * Copies the k strongest combinations (the nut hands), strongest
+     * first, and returns the number copied. Either output array may be
+     * null.
+     */
+    int GetTopHands(int k, Hand *holes, HandStrength *strengths) const;
+
+private:
+    /// Returns the slot of a pair of hole cards, i.e. its combo index.
+    static int GetSlot(const Hand &hole)
+    {
+        return GetComboIndex(hole);
+    }
+
+    /// Range of sorted positions [begin, end) that hold the strength of a
+    /// combination; both are zero for a dead combination.
+    struct Slot
+    {
+        uint16_t begin;
+        uint16_t end;
+    };
+
+    int num_combos_;
+    Hand holes_[MAX_BOARD_COMBOS];        // combinations, strongest first
+    HandStrength strengths_[MAX_BOARD_COMBOS]; // their strengths
+    Slot slots_[NUM_COMBOS];              // indexed by GetSlot()
+};
+
+#endif /* HOLDEM_STRENGTH_INDEX_H */
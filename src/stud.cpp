@@ -0,0 +1,291 @@
+#include "stud.h"
+#include "deck.h"
+#include "parallel.h"
+#include <random>
+#include <vector>
+
+#define MAX_STUD_PLAYERS 8
+
+/// Accumulates the showdown results of one thread.
+struct StudTally
+{
+    double win[MAX_STUD_PLAYERS];
+    double tie[MAX_STUD_PLAYERS];
+    double share[MAX_STUD_PLAYERS];
+    double num_deals;
+
+    StudTally() : num_deals(0)
+    {
+        for (int i = 0; i < MAX_STUD_PLAYERS; i++)
+            win[i] = tie[i] = share[i] = 0;
+    }
+
+    void Merge(const StudTally &a)
+    {
+        for (int i = 0; i < MAX_STUD_PLAYERS; i++)
+        {
+            win[i] += a.win[i];
+            tie[i] += a.tie[i];
+            share[i] += a.share[i];
+        }
+        num_deals += a.num_deals;
+    }
+};
+
+/// Splits the pot among the seven-card hands of all players and records
+/// the result in the tally.
+static void Showdown(const Hand *hands, int num_players, StudGame game,
+                     StudTally &tally)
+{
+    HandStrength high[MAX_STUD_PLAYERS];
+    EvaluateHands(hands, high, num_players);
+
+    HandStrength best_high = high[0];
+    for (int i = 1; i < num_players; i++)
+    {
+        if (high[i] > best_high)
+            best_high = high[i];
+    }
+
+    LowStrength low[MAX_STUD_PLAYERS];
+    LowStrength best_low;
+    if (game == StudHiLo)
+    {
+        for (int i = 0; i < num_players; i++)
+        {
+            low[i] = EvaluateLow(hands[i]);
+            if (low[i] > best_low)
+                best_low = low[i];
+        }
+    }
+
+    // The high half is the whole pot if nobody has a qualifying low.
+    int num_high = 0, num_low = 0;
+    for (int i = 0; i < num_players; i++)
+    {
+        num_high += (high[i] == best_high);
+        num_low += (best_low.value != 0 && low[i] == best_low);
+    }
+    double high_pot = (num_low > 0)? 0.5 : 1.0;
+
+    for (int i = 0; i < num_players; i++)
+    {
+        double share = 0;
+        if (high[i] == best_high)
+            share += high_pot / num_high;
+        if (num_low > 0 && low[i] == best_low)
+            share += (1.0 - high_pot) / num_low;
+
+        tally.share[i] += share;
+        if (share == 1.0)
+            tally.win[i] += 1;
+        else if (share > 0)
+            tally.tie[i] += 1;
+    }
+    tally.num_deals += 1;
+}
+
+/// Returns the number of cards each player still has to receive, or -1 if
+/// the hand is invalid.
+static int GetCardsToDeal(const StudHand &hand, int need[], CardSet &known)
+{
+    if (hand.num_players < 2 || hand.num_players > MAX_STUD_PLAYERS)
+        return -1;
+
+    known = hand.dead;
+    int total = 0;
+    for (int i = 0; i < hand.num_players; i++)
+    {
+        int n = hand.players[i].GetCardCount();
+        if (n > 7 || (known & hand.players[i].GetCardSet()) != 0)
+            return -1;
+        known |= hand.players[i].GetCardSet();
+        need[i] = 7 - n;
+        total += need[i];
+    }
+
+    Deck deck(known);
+    return (total <= deck.num_cards)? total : -1;
+}
+
+static void FinishResult(const StudTally &tally, int num_players,
+                         StudEquity *result)
+{
+    for (int i = 0; i < num_players; i++)
+    {
+        result[i].win = tally.win[i] / tally.num_deals;
+        result[i].tie = tally.tie[i] / tally.num_deals;
+        result[i].equity = tally.share[i] / tally.num_deals;
+    }
+}
+
+double CountStudDeals(const StudHand &hand)
+{
+    int need[MAX_STUD_PLAYERS];
+    CardSet known;
+    if (GetCardsToDeal(hand, need, known) < 0)
+        return 0;
+
+    int n = Deck(known).num_cards;
+    double count = 1;
+    for (int i = 0; i < hand.num_players; i++)
+    {
+        count *= Choose(n, need[i]);
+        n -= need[i];
+    }
+    return count;
+}
+
+/**
+ * Enumerates the deals of a stud hand player by player. Each level picks a
+ * combination of cards for one player from the cards not yet used by the
+ * previous levels, and the last level runs the showdown.
+ */
+class StudEnumerator
+{
+public:
+    StudEnumerator(const StudHand &hand, const int need[], CardSet known)
+        : hand_(hand), need_(need), deck_(known) { }
+
+    /// Enumerates the deals in which player 'level' receives the given
+    /// cards, all previous players having been dealt already.
+    void Enumerate(int level, Hand hands[], CardSet used, StudTally &tally)
+    {
+        if (level == hand_.num_players)
+        {
+            Showdown(hands, hand_.num_players, hand_.game, tally);
+            return;
+        }
+        if (need_[level] == 0)
+        {
+            Enumerate(level + 1, hands, used, tally);
+            return;
+        }
+
+        Hand avail[52];
+        int num_avail = GetAvailable(used, avail);
+        Hand base = hands[level];
+        ForEachCombination(num_avail, need_[level], [&](const int *index)
+        {
+            Hand dealt;
+            for (int i = 0; i < need_[level]; i++)
+                dealt += avail[index[i]];
+            hands[level] = base + dealt;
+            Enumerate(level + 1, hands, used | dealt.GetCardSet(), tally);
+        });
+        hands[level] = base;
+    }
+
+    /// Collects the live cards not in the given set.
+    int GetAvailable(CardSet used, Hand avail[]) const
+    {
+        int n = 0;
+        for (int i = 0; i < deck_.num_cards; i++)
+        {
+            if ((deck_.cards[i].value & used) == 0)
+                avail[n++] = deck_.cards[i];
+        }
+        return n;
+    }
+
+private:
+    const StudHand &hand_;
+    const int *need_;
+    Deck deck_;
+};
+
+bool EnumerateStudEquity(const StudHand &hand, StudEquity *result)
+{
+    int need[MAX_STUD_PLAYERS];
+    CardSet known;
+    if (GetCardsToDeal(hand, need, known) < 0)
+        return false;
+
+    StudEnumerator enumerator(hand, need, known);
+
+    // Split the work on the first player who has cards to receive: list
+    // all combinations for that player, and let each thread enumerate the
+    // remaining players for a slice of the list.
+    int first = 0;
+    while (first < hand.num_players && need[first] == 0)
+        ++first;
+
+    std::vector<Hand> first_deals;
+    if (first < hand.num_players)
+    {
+        Hand avail[52];
+        int num_avail = enumerator.GetAvailable(0, avail);
+        ForEachCombination(num_avail, need[first], [&](const int *index)
+        {
+            Hand dealt;
+            for (int i = 0; i < need[first]; i++)
+                dealt += avail[index[i]];
+            first_deals.push_back(dealt);
+        });
+    }
+    else
+    {
+        first_deals.push_back(Hand());
+    }
+
+    int num_threads = GetThreadCount();
+    std::vector<StudTally> tallies(num_threads);
+    ParallelFor((int64_t)first_deals.size(), num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        Hand hands[MAX_STUD_PLAYERS];
+        for (int64_t k = begin; k < end; k++)
+        {
+            for (int i = 0; i < hand.num_players; i++)
+                hands[i] = hand.players[i];
+            if (first < hand.num_players)
+                hands[first] += first_deals[k];
+            enumerator.Enumerate(first + 1, hands,
+                                 first_deals[k].GetCardSet(), tallies[thread]);
+        }
+    });
+
+    StudTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+    FinishResult(total, hand.num_players, result);
+    return true;
+}
+
+bool SimulateStudEquity(const StudHand &hand, int num_trials,
+                        unsigned int seed, StudEquity *result)
+{
+    int need[MAX_STUD_PLAYERS];
+    CardSet known;
+    int total_need = GetCardsToDeal(hand, need, known);
+    if (total_need < 0 || num_trials <= 0)
+        return false;
+
+    int num_threads = GetThreadCount();
+    std::vector<StudTally> tallies(num_threads);
+    ParallelFor(num_trials, num_threads,
+        [&](int thread, int64_t begin, int64_t end)
+    {
+        std::mt19937 engine(seed + thread);
+        Deck deck(known);
+        Hand hands[MAX_STUD_PLAYERS];
+        for (int64_t k = begin; k < end; k++)
+        {
+            deck.Deal(engine, total_need);
+            int next = 0;
+            for (int i = 0; i < hand.num_players; i++)
+            {
+                hands[i] = hand.players[i];
+                for (int j = 0; j < need[i]; j++)
+                    hands[i] += deck.cards[next++];
+            }
+            Showdown(hands, hand.num_players, hand.game, tallies[thread]);
+        }
+    });
+
+    StudTally total;
+    for (int t = 0; t < num_threads; t++)
+        total.Merge(tallies[t]);
+    FinishResult(total, hand.num_players, result);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef HOLDEM_STUD_H
+#define HOLDEM_STUD_H
+
+#include "hand.h"
+
+/// Represents a variant of seven-card stud.
+enum StudGame
+{
+    StudHigh = 0,	/* best high hand takes the pot */
+    StudHiLo = 1	/* pot split between high and eight-or-better low */
+};
+
+/// Represents the outcome of a seven-card stud showdown for one player.
+struct StudEquity
+{
+    double win;		/* probability of taking the whole pot alone */
+    double tie;		/* probability of taking part of the pot */
+    double equity;	/* expected share of the pot */
+};
+
+/**
+ * Describes a seven-card stud hand to be played to showdown.
+ *
+ * Each player's known cards include the up-cards plus any down-cards that
+ * are known (such as the hero's own); every player receives the remaining
+ * cards up to seven from the live deck. Dead cards are cards known to be
+ * out of play, such as the up-cards of folded players.
+ */
+struct StudHand
+{
+    const Hand *players;
+    int num_players;
+    CardSet dead;
+    StudGame game;
+};
+
+/**
+ * Returns the number of distinct ways to deal the unknown cards of a stud
+ * hand. This tells whether exact enumeration is affordable; the count
+ * grows very quickly with the number of unknown cards.
+ */
+double CountStudDeals(const StudHand &hand);
+
+/**
+ * Computes the exact equity of each player by enumerating every way to
+ * deal the unknown cards. The enumeration is split across threads on the
+ * first player that has cards to receive. Returns false if the hand is
+ * invalid (e.g. more than 7 known cards, or not enough live cards).
+ */
+bool EnumerateStudEquity(const StudHand &hand, StudEquity *result);
+
+/**
+ * Estimates the equity of each player by dealing num_trials random
+ * completions of the hand, split across threads. Returns false if the hand
+ * is invalid.
+ */
+bool SimulateStudEquity(const StudHand &hand, int num_trials,
+                        unsigned int seed, StudEquity *result);
+
+#endif /* HOLDEM_STUD_H */